@@ -11,8 +11,6 @@
 
 // External libraries
 #include <nlohmann/json.hpp>
-#define OPENSSL_SUPPRESS_DEPRECATED
-#include <openssl/sha.h>
 
 // Color definitions
 #define RED   "\x1B[31m"
@@ -3,19 +3,39 @@
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <set>
 #include "../models/branch.hpp"
+#include "repoTransaction.hpp"
 
+// Branch refs, stored like this:
+//
+//   .vcs/HEAD                  "ref: refs/heads/<current branch>"
+//   .vcs/refs/heads/<branch>   tip commit id, empty for a branch with no commits
+//
+// Changes are kept in memory until flush(), which replaces only the refs
+// that changed, so updating a branch costs the same however many branches
+// and commits exist. A ref is only replaced if it still holds what this
+// process read, so a concurrent update of the same branch is not lost.
 class BranchManager {
 private:
     std::unordered_map<std::string, std::shared_ptr<Branch>> branches;
     std::string currentBranch;
+    std::unordered_map<std::string, std::string> refContents;  // ref files as read
+    std::set<std::string> dirtyRefs;
+    bool headDirty = false;
+    std::string legacyJsonPath;  // converted branches.json, deleted by the next flush
 
-    void saveBranchState() const;
     void loadBranchState();
+    void loadRefs(const std::string& dir, const std::string& prefix);
+    void loadBranchesJson(const std::string& jsonPath);
 
 public:
     BranchManager();
-    ~BranchManager();
+
+    static bool isValidName(const std::string& name);
+
+    // Queue the refs and HEAD changes made by this command
+    void flush(RepoTransaction& tx);
 
     bool createBranch(const std::string& name, const std::string& startCommit = "");
     bool switchBranch(const std::string& name);
@@ -26,4 +46,4 @@ public:
     std::vector<std::string> getAllBranches() const;
     bool branchExists(const std::string& name) const;
     std::string getBranchCommit(const std::string& branchName) const;
-};
\ No newline at end of file
+};
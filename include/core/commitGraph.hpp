@@ -0,0 +1,176 @@
+#pragma once
+#include "../utils/pathUtils.hpp"
+#include "../utils/binaryIO.hpp"
+#include "../utils/mappedFile.hpp"
+#include "repoTransaction.hpp"
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+// Parent links and generation numbers for every commit, in
+// .vcs/commit-graph. Commits are numbered by their position in the commit
+// log, so the graph is a dense array with one fixed-size entry per commit:
+//
+//   "VCGR" | version u32 | entries in log order
+//   entry: generation u32 | parent position u32 | second parent position u32
+//
+// A missing parent is NO_PARENT. Root commits have generation 1 and every
+// other commit one more than its highest parent, so an ancestor always has a
+// lower generation than its descendants and a walk can stop once it is
+// below the generation it is looking for.
+//
+// The file grows by one entry per commit, written by flush() along with the
+// commit log. Entries that are missing, zeroed by a crash or not backed by
+// the log are recomputed from the commit records on open.
+class CommitGraph {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+    static constexpr size_t HEADER_SIZE = 8;
+    static constexpr size_t ENTRY_SIZE = 12;
+
+    struct Entry {
+        uint32_t generation = 0;
+        uint32_t parents[2] = {NO_PARENT, NO_PARENT};
+    };
+
+private:
+    std::string graphPath;
+    MappedFile mapped;
+    size_t mappedCount = 0;
+    std::vector<Entry> appended;  // entries added since the file was mapped
+    bool fileValid = false;       // the file exists and has a valid header
+    uint64_t fileSize = 0;
+    size_t storedCount = 0;       // valid entries in the file
+
+    Entry mappedEntry(size_t pos) const {
+        const unsigned char* p = mapped.data() + HEADER_SIZE + pos * ENTRY_SIZE;
+        Entry entry;
+        entry.generation = BinaryIO::getU32(p);
+        entry.parents[0] = BinaryIO::getU32(p + 4);
+        entry.parents[1] = BinaryIO::getU32(p + 8);
+        return entry;
+    }
+
+public:
+    CommitGraph() : graphPath(PathUtils::joinPath(".vcs", "commit-graph")) {}
+
+    // Map the graph for a log of logSize commits, of which the first stored
+    // ones were already on disk. Entries the file is missing are computed in
+    // order from parentsOf(position), which returns the parent positions of
+    // a commit.
+    void open(size_t logSize, size_t stored, const std::function<std::vector<uint32_t>(uint32_t)>& parentsOf) {
+        mapped.close();
+        appended.clear();
+        fileValid = false;
+        fileSize = 0;
+        size_t count = 0;
+        if (mapped.open(graphPath)) {
+            fileSize = mapped.size();
+            fileValid = mapped.size() >= HEADER_SIZE && std::memcmp(mapped.data(), "VCGR", 4) == 0 &&
+                        BinaryIO::getU32(mapped.data() + 4) == VERSION;
+        }
+        if (fileValid) {
+            count = std::min((mapped.size() - HEADER_SIZE) / ENTRY_SIZE, stored);
+            // Drop trailing entries that never made it to disk intact
+            while (count > 0 && mappedEntry(count - 1).generation == 0) --count;
+        }
+        mappedCount = storedCount = count;
+        for (size_t pos = count; pos < logSize; ++pos) {
+            append(parentsOf(static_cast<uint32_t>(pos)));
+        }
+    }
+
+    size_t size() const { return mappedCount + appended.size(); }
+
+    Entry entry(uint32_t pos) const {
+        return pos < mappedCount ? mappedEntry(pos) : appended.at(pos - mappedCount);
+    }
+
+    // Add the next commit, given the positions of its parents
+    void append(const std::vector<uint32_t>& parents) {
+        if (parents.size() > 2) throw std::runtime_error("Commits with more than two parents are not supported");
+        Entry entry;
+        entry.generation = 1;
+        for (size_t i = 0; i < parents.size(); ++i) {
+            if (parents[i] >= size()) throw std::runtime_error("Commit graph parent out of range");
+            entry.parents[i] = parents[i];
+            entry.generation = std::max(entry.generation, this->entry(parents[i]).generation + 1);
+        }
+        appended.push_back(entry);
+    }
+
+    // Queue the entries not yet in the file, cutting off any invalid tail
+    void flush(RepoTransaction& tx) {
+        uint64_t storedEnd = HEADER_SIZE + storedCount * ENTRY_SIZE;
+        if (storedCount == size() && (fileValid ? fileSize == storedEnd : size() == 0)) return;
+        std::string data;
+        for (size_t pos = storedCount; pos < size(); ++pos) {
+            Entry item = entry(static_cast<uint32_t>(pos));
+            BinaryIO::putU32(data, item.generation);
+            BinaryIO::putU32(data, item.parents[0]);
+            BinaryIO::putU32(data, item.parents[1]);
+        }
+        if (fileValid) {
+            tx.extend(graphPath, fileSize, storedEnd, data);
+        } else {
+            std::string header("VCGR", 4);
+            BinaryIO::putU32(header, VERSION);
+            tx.replace(graphPath, header + data);
+        }
+        fileValid = true;
+        storedCount = size();
+        fileSize = HEADER_SIZE + storedCount * ENTRY_SIZE;
+    }
+
+    // Best common ancestor of two commits, or NO_PARENT if they share none.
+    // Both histories are walked together, highest generation first, through
+    // all parents; the first commit reached from both sides is a common
+    // ancestor that no other common ancestor descends from.
+    uint32_t mergeBase(uint32_t a, uint32_t b) const {
+        if (a == b) return a;
+        enum : uint8_t { FROM_A = 1, FROM_B = 2 };
+        std::unordered_map<uint32_t, uint8_t> flags;
+        std::priority_queue<std::pair<uint32_t, uint32_t>> queue;  // (generation, position)
+        auto reach = [&](uint32_t pos, uint8_t flag) {
+            uint8_t& seen = flags[pos];
+            if ((seen & flag) == flag) return;
+            seen |= flag;
+            queue.push({entry(pos).generation, pos});
+        };
+        reach(a, FROM_A);
+        reach(b, FROM_B);
+        while (!queue.empty()) {
+            uint32_t pos = queue.top().second;
+            queue.pop();
+            // Every descendant of pos has a higher generation and was popped
+            // already, so its flags are final here
+            uint8_t seen = flags[pos];
+            if (seen == (FROM_A | FROM_B)) return pos;
+            for (uint32_t parent : entry(pos).parents) {
+                if (parent != NO_PARENT) reach(parent, seen);
+            }
+        }
+        return NO_PARENT;
+    }
+
+    // True if ancestor is descendant itself or reachable from it through
+    // parent links. Commits below the ancestor's generation are never visited.
+    bool isAncestor(uint32_t ancestor, uint32_t descendant) const {
+        uint32_t floor = entry(ancestor).generation;
+        std::vector<uint32_t> stack{descendant};
+        std::unordered_set<uint32_t> visited;
+        while (!stack.empty()) {
+            uint32_t pos = stack.back();
+            stack.pop_back();
+            if (pos == ancestor) return true;
+            if (!visited.insert(pos).second) continue;
+            for (uint32_t parent : entry(pos).parents) {
+                if (parent != NO_PARENT && entry(parent).generation >= floor) stack.push_back(parent);
+            }
+        }
+        return false;
+    }
+};
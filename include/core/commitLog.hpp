@@ -0,0 +1,289 @@
+#pragma once
+#include "../models/commit.hpp"
+#include "../utils/pathUtils.hpp"
+#include "../utils/binaryIO.hpp"
+#include "../utils/mappedFile.hpp"
+#include "repoTransaction.hpp"
+#include <cstring>
+#include <unordered_map>
+
+// Append-only store of commit records:
+//
+//   .vcs/commits.log: "VCLG" | version u32 | records...
+//     record: body length u32 | crc32 u32 | body (see Commit::encode)
+//   .vcs/commits.idx: "VCIX" | version u32 | entries in log order
+//     entry: commit id slot[33] | record offset u64
+//
+// New commits are kept in memory until flush() queues them as extensions
+// of both files, so the cost of a commit does not grow with history. A
+// record counts only once its length and checksum are intact: open() ignores
+// a torn record at the end of the log and indexes records that never reached
+// the index, and the next flush cuts off the one and writes the other.
+//
+// Both files are mapped rather than read, and open() checks only the end of
+// the index, so opening the log costs the same for any history length. A
+// commit's position is its entry number in the index. Lookups by id scan
+// the most recent entries first and build a hash table of the rest only
+// when an older commit is asked for.
+class CommitLog {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 8;
+    static constexpr size_t RECORD_HEADER_SIZE = 8;
+    static constexpr size_t INDEX_ENTRY_SIZE = Commit::ID_SLOT_SIZE + 8;
+    static constexpr size_t RECENT_SCAN = 256;  // entries searched before building the table
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+private:
+    std::string logPath;
+    std::string indexPath;
+    MappedFile mapped;        // the log as of open(); later records are read from the file
+    MappedFile mappedIndex;   // the index as of open()
+    size_t mappedCount = 0;   // valid entries in mappedIndex
+    std::vector<std::string> addedSlots;  // id slots of records indexed after open()
+    std::vector<uint64_t> addedOffsets;
+    std::unordered_map<std::string, uint32_t> addedPositions;
+    mutable std::unordered_map<std::string, uint32_t> mappedPositions;  // by id slot, built on demand
+    mutable bool mappedPositionsBuilt = false;
+    bool logOnDisk = false;
+    uint64_t logFileSize = 0;         // size of the log file, torn tail included
+    uint64_t logSize = HEADER_SIZE;   // end of the intact records on disk
+    std::string pendingRecords;       // records appended since the last flush
+    bool indexOnDisk = false;
+    uint64_t indexFileSize = 0;
+    size_t indexedCount = 0;          // entries in the index file that are valid
+
+    static std::string header(const char* magic) {
+        std::string out(magic, 4);
+        BinaryIO::putU32(out, VERSION);
+        return out;
+    }
+
+    // Check the record at offset; returns its total size, or 0 if it is torn
+    // or corrupt
+    static uint64_t recordSize(const MappedFile& log, uint64_t offset) {
+        if (log.size() < offset + RECORD_HEADER_SIZE) return 0;
+        const unsigned char* p = log.data() + offset;
+        uint32_t length = BinaryIO::getU32(p);
+        if (log.size() - offset - RECORD_HEADER_SIZE < length) return 0;
+        if (BinaryIO::crc32(p + RECORD_HEADER_SIZE, length) != BinaryIO::getU32(p + 4)) return 0;
+        return RECORD_HEADER_SIZE + length;
+    }
+
+    // Id slot for a commit id, or "" if no commit can have that id
+    static std::string slotFor(const std::string& id) {
+        std::string slot;
+        if (id.empty()) return slot;
+        try {
+            Commit::putId(slot, id);
+        } catch (const std::runtime_error&) {
+            return "";
+        }
+        return slot;
+    }
+
+    const unsigned char* indexEntry(size_t pos) const {
+        return mappedIndex.data() + HEADER_SIZE + pos * INDEX_ENTRY_SIZE;
+    }
+
+    const unsigned char* slotAt(size_t pos) const {
+        if (pos < mappedCount) return indexEntry(pos);
+        return reinterpret_cast<const unsigned char*>(addedSlots[pos - mappedCount].data());
+    }
+
+    uint64_t offsetAt(size_t pos) const {
+        if (pos < mappedCount) return BinaryIO::getU64(indexEntry(pos) + Commit::ID_SLOT_SIZE);
+        return addedOffsets[pos - mappedCount];
+    }
+
+    static std::string encodeRecord(const Commit& commit) {
+        std::string body = commit.encode();
+        std::string record;
+        BinaryIO::putU32(record, static_cast<uint32_t>(body.size()));
+        BinaryIO::putU32(record, BinaryIO::crc32(reinterpret_cast<const unsigned char*>(body.data()), body.size()));
+        return record + body;
+    }
+
+    void indexRecord(std::string slot, uint64_t offset) {
+        addedPositions.emplace(slot, static_cast<uint32_t>(size()));
+        addedSlots.push_back(std::move(slot));
+        addedOffsets.push_back(offset);
+    }
+
+    // Index the intact records from offset on; returns the end of the last one
+    uint64_t recover(const MappedFile& log, uint64_t offset) {
+        while (uint64_t size = recordSize(log, offset)) {
+            const char* body = reinterpret_cast<const char*>(log.data() + offset + RECORD_HEADER_SIZE);
+            indexRecord(std::string(body, Commit::ID_SLOT_SIZE), offset);
+            offset += size;
+        }
+        return offset;
+    }
+
+    // Size of the record an index entry points to, or 0 if the entry is not
+    // backed by an intact record of the same commit
+    uint64_t checkEntry(const MappedFile& log, size_t pos) const {
+        const unsigned char* entry = indexEntry(pos);
+        uint64_t offset = BinaryIO::getU64(entry + Commit::ID_SLOT_SIZE);
+        if (offset < HEADER_SIZE) return 0;
+        uint64_t size = recordSize(log, offset);
+        if (size < RECORD_HEADER_SIZE + Commit::ID_SLOT_SIZE) return 0;
+        if (std::memcmp(log.data() + offset + RECORD_HEADER_SIZE, entry, Commit::ID_SLOT_SIZE) != 0) return 0;
+        return size;
+    }
+
+public:
+    CommitLog()
+        : logPath(PathUtils::joinPath(".vcs", "commits.log"))
+        , indexPath(PathUtils::joinPath(".vcs", "commits.idx")) {}
+
+    // Map the log and its index. Nothing is written: damage left by an
+    // interrupted write is skipped here and repaired by the next flush.
+    void open() {
+        mapped.close();
+        mappedIndex.close();
+        mappedCount = 0;
+        addedSlots.clear();
+        addedOffsets.clear();
+        addedPositions.clear();
+        mappedPositions.clear();
+        mappedPositionsBuilt = false;
+        pendingRecords.clear();
+        logOnDisk = indexOnDisk = false;
+        logFileSize = indexFileSize = 0;
+        logSize = HEADER_SIZE;
+        indexedCount = 0;
+        MappedFile log;
+        if (!log.open(logPath)) return;
+        if (log.size() < HEADER_SIZE || std::memcmp(log.data(), "VCLG", 4) != 0 ||
+            BinaryIO::getU32(log.data() + 4) != VERSION) {
+            throw std::runtime_error("Unreadable commit log: " + logPath);
+        }
+        logOnDisk = true;
+        logFileSize = log.size();
+        uint64_t next = HEADER_SIZE;  // log offset just past the last indexed record
+        if (mappedIndex.open(indexPath) && mappedIndex.size() >= HEADER_SIZE &&
+            std::memcmp(mappedIndex.data(), "VCIX", 4) == 0 && BinaryIO::getU32(mappedIndex.data() + 4) == VERSION) {
+            indexOnDisk = true;
+            indexFileSize = mappedIndex.size();
+            // Index entries are written after their records, so only entries
+            // at the end of the index can be ahead of the log
+            size_t count = (mappedIndex.size() - HEADER_SIZE) / INDEX_ENTRY_SIZE;
+            while (count > 0) {
+                if (uint64_t size = checkEntry(log, count - 1)) {
+                    next = BinaryIO::getU64(indexEntry(count - 1) + Commit::ID_SLOT_SIZE) + size;
+                    break;
+                }
+                --count;
+            }
+            mappedCount = indexedCount = count;
+        } else {
+            mappedIndex.close();  // missing or damaged: rebuilt from the log
+        }
+        logSize = recover(log, next);
+        mapped = std::move(log);
+    }
+
+    // Whether the log existed when it was opened
+    bool onDisk() const { return logOnDisk; }
+
+    size_t size() const { return mappedCount + addedSlots.size(); }
+
+    // Id of the commit at a log position
+    std::string id(uint32_t pos) const { return Commit::getId(slotAt(pos)); }
+
+    // Id of the most recently appended commit
+    std::string last() const { return size() == 0 ? "" : id(static_cast<uint32_t>(size() - 1)); }
+
+    // Position of a commit in the log, or NONE
+    uint32_t position(const std::string& id) const {
+        std::string slot = slotFor(id);
+        if (slot.empty()) return NONE;
+        auto added = addedPositions.find(slot);
+        if (added != addedPositions.end()) return added->second;
+        if (!mappedPositionsBuilt) {
+            size_t stop = mappedCount > RECENT_SCAN ? mappedCount - RECENT_SCAN : 0;
+            for (size_t pos = mappedCount; pos > stop; --pos) {
+                if (std::memcmp(indexEntry(pos - 1), slot.data(), Commit::ID_SLOT_SIZE) == 0) {
+                    return static_cast<uint32_t>(pos - 1);
+                }
+            }
+            if (stop == 0) return NONE;
+            mappedPositions.reserve(mappedCount);
+            for (size_t pos = 0; pos < mappedCount; ++pos) {
+                const char* entry = reinterpret_cast<const char*>(indexEntry(pos));
+                mappedPositions.emplace(std::string(entry, Commit::ID_SLOT_SIZE), static_cast<uint32_t>(pos));
+            }
+            mappedPositionsBuilt = true;
+        }
+        auto it = mappedPositions.find(slot);
+        return it != mappedPositions.end() ? it->second : NONE;
+    }
+
+    bool contains(const std::string& id) const { return position(id) != NONE; }
+
+    // Read and decode the commit at a log position
+    std::shared_ptr<Commit> read(uint32_t pos) const {
+        uint64_t offset = offsetAt(pos);
+        if (offset >= logSize) {
+            const unsigned char* record = reinterpret_cast<const unsigned char*>(pendingRecords.data()) + (offset - logSize);
+            return std::make_shared<Commit>(Commit::decode(record + RECORD_HEADER_SIZE, BinaryIO::getU32(record)));
+        }
+        if (uint64_t size = recordSize(mapped, offset)) {
+            const unsigned char* body = mapped.data() + offset + RECORD_HEADER_SIZE;
+            return std::make_shared<Commit>(Commit::decode(body, size - RECORD_HEADER_SIZE));
+        }
+        std::ifstream in(logPath, std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(offset));
+        unsigned char recordHeader[RECORD_HEADER_SIZE];
+        in.read(reinterpret_cast<char*>(recordHeader), RECORD_HEADER_SIZE);
+        std::string body(BinaryIO::getU32(recordHeader), '\0');
+        in.read(&body[0], body.size());
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(body.data());
+        if (!in || BinaryIO::crc32(p, body.size()) != BinaryIO::getU32(recordHeader + 4)) {
+            throw std::runtime_error("Corrupt commit record: " + id(pos));
+        }
+        return std::make_shared<Commit>(Commit::decode(p, body.size()));
+    }
+
+    // Read and decode one commit, or return nullptr if it is not in the log
+    std::shared_ptr<Commit> read(const std::string& id) const {
+        uint32_t pos = position(id);
+        return pos == NONE ? nullptr : read(pos);
+    }
+
+    // Add a commit; it is written by the next flush
+    void append(const Commit& commit) {
+        std::string record = encodeRecord(commit);
+        indexRecord(slotFor(commit.id), logSize + pendingRecords.size());
+        pendingRecords += record;
+    }
+
+    // Queue new records and index entries, and the repair of anything open()
+    // skipped, as extensions of the two files
+    void flush(RepoTransaction& tx) {
+        if (!logOnDisk) {
+            if (pendingRecords.empty()) return;
+            tx.replace(logPath, header("VCLG") + pendingRecords);
+        } else if (!pendingRecords.empty() || logFileSize != logSize) {
+            tx.extend(logPath, logFileSize, logSize, pendingRecords);
+        }
+        std::string entries;
+        for (size_t pos = indexedCount; pos < size(); ++pos) {
+            entries.append(reinterpret_cast<const char*>(slotAt(pos)), Commit::ID_SLOT_SIZE);
+            BinaryIO::putU64(entries, offsetAt(pos));
+        }
+        uint64_t indexEnd = HEADER_SIZE + indexedCount * INDEX_ENTRY_SIZE;
+        if (!indexOnDisk) {
+            tx.replace(indexPath, header("VCIX") + entries);
+        } else if (!entries.empty() || indexFileSize != indexEnd) {
+            tx.extend(indexPath, indexFileSize, indexEnd, entries);
+        }
+        logSize += pendingRecords.size();
+        logFileSize = logSize;
+        pendingRecords.clear();
+        logOnDisk = indexOnDisk = true;
+        indexedCount = size();
+        indexFileSize = HEADER_SIZE + indexedCount * INDEX_ENTRY_SIZE;
+    }
+};
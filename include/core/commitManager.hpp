@@ -3,242 +3,496 @@
 #include "../utils/pathUtils.hpp"
 #include "../utils/hashUtils.hpp"
 #include "../utils/huffmanCoder.hpp"
+#include "../utils/threadPool.hpp"
+#include "../utils/dirWalker.hpp"
+#include "../utils/lruCache.hpp"
+#include "../utils/lineMerge.hpp"
 #include "../common.hpp"
+#include "objectStore.hpp"
+#include "index.hpp"
+#include "commitLog.hpp"
+#include "commitGraph.hpp"
+#include "treeStore.hpp"
+#include <functional>
+#include <optional>
+#include <set>
 
 class CommitManager {
 private:
-    std::unordered_map<std::string, std::shared_ptr<Commit>> commits;
-    std::string head;
-    void saveCommitState() const {
+    // Commits are decoded from the log when first asked for and kept in an
+    // LRU cache whose cost is the number of files each one lists
+    static constexpr size_t COMMIT_CACHE_FILES = 1 << 18;
+    mutable LruCache<std::string, std::shared_ptr<Commit>> commitCache{COMMIT_CACHE_FILES};
+    CommitLog commitLog;
+    CommitGraph commitGraph;
+    std::string legacyJsonPath;  // converted commits.json, deleted by the next flush
+    std::vector<std::string> legacyDataDirs;  // migrated .vcs/commits/<id>, deleted by the next flush
+    ObjectStore objectStore;
+    TreeStore treeStore{objectStore};
+    mutable std::unordered_map<std::string, std::string> legacyRoots;  // commit id -> virtual root tree
+    FileCopy::Stats copyStats;  // file data copied since the last takeCopyStats
+    std::vector<std::string> mergeConflicts;  // paths left with conflicts since the last takeMergeConflicts
+    void loadCommitState() {
+        if (!PathUtils::isDirectory(".vcs")) return;
+        commitLog.open();
+        size_t stored = commitLog.size();
+        std::string jsonPath = PathUtils::joinPath(".vcs", "commits.json");
+        if (!commitLog.onDisk() && PathUtils::exists(jsonPath)) convertJsonCommits(jsonPath);
+        commitGraph.open(commitLog.size(), stored, [this](uint32_t pos) {
+            return parentPositions(*commitLog.read(pos));
+        });
+    }
+    // Commits used to be kept in .vcs/commits.json, rewritten in full on every
+    // change. Add them to the commit log, parents before children and the
+    // head last; the next flush writes the log and deletes the JSON file.
+    void convertJsonCommits(const std::string& jsonPath) {
         json j;
-        j["head"] = head;
-        json commitsJson;
-        for (const auto& [id, commit] : commits) {
-            commitsJson[id] = commit->toJson();
+        try {
+            std::ifstream file(jsonPath);
+            j = json::parse(file);
+        } catch (const json::exception& e) {
+            throw std::runtime_error("Could not parse " + jsonPath + ": " + e.what());
+        }
+        std::unordered_map<std::string, std::shared_ptr<Commit>> legacy;
+        for (const auto& [id, commitData] : j["commits"].items()) {
+            legacy[id] = std::make_shared<Commit>(Commit::fromJson(commitData));
         }
-        j["commits"] = commitsJson;
-        std::ofstream file(PathUtils::joinPath(".vcs", "commits.json"));
-        file << j.dump(4);
+        std::string legacyHead = j.value("head", "");
+        std::vector<std::shared_ptr<Commit>> ordered;
+        std::unordered_set<std::string> visited;
+        std::function<void(const std::string&)> visit = [&](const std::string& id) {
+            auto it = legacy.find(id);
+            if (it == legacy.end() || !visited.insert(id).second) return;
+            for (const auto& parent : it->second->parentIds) visit(parent);
+            ordered.push_back(it->second);
+        };
+        std::vector<std::string> ids;
+        for (const auto& [id, _] : legacy) ids.push_back(id);
+        std::sort(ids.begin(), ids.end());
+        for (const auto& id : ids) {
+            if (id != legacyHead) visit(id);
+        }
+        visit(legacyHead);
+        for (const auto& commit : ordered) commitLog.append(*commit);
+        legacyJsonPath = jsonPath;
     }
-    void loadCommitState() {
-        try {
-            std::ifstream file(PathUtils::joinPath(".vcs", "commits.json"));
-            if (file.is_open()) {
-                json j = json::parse(file);
-                head = j["head"];
-                for (const auto& [id, commitData] : j["commits"].items()) {
-                    commits[id] = std::make_shared<Commit>(Commit::fromJson(commitData));
-                }
-            }
-        } catch (...) {
-            head = "";
-        }
-    }
-    std::string computeFileHash(const std::string& filePath) const {
-        std::ifstream file(filePath, std::ios::binary);
-        if (!file) return "";
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        return HashUtils::computeSHA256(buffer.str());
-    }
-    static std::string getDirectory(const std::string& path) {
-        size_t pos = path.find_last_of('/');
-        return pos == std::string::npos ? "" : path.substr(0, pos);
-    }
-    std::string findMergeBase(const std::string& commit1, const std::string& commit2) {
-        if (commit1.empty() || commit2.empty()) return "";
-        std::unordered_set<std::string> ancestors1;
-        std::string current = commit1;
-        while (!current.empty()) {
-            ancestors1.insert(current);
-            auto commit = getCommit(current);
-            if (!commit || commit->parentIds.empty()) break;
-            current = commit->parentIds[0];
-        }
-        current = commit2;
-        while (!current.empty()) {
-            if (ancestors1.count(current) > 0) return current;
-            auto commit = getCommit(current);
-            if (!commit || commit->parentIds.empty()) break;
-            current = commit->parentIds[0];
-        }
-        return "";
-    }
-    void mergeFiles(const std::string& baseCommit, const std::string& sourceCommit, 
-                const std::string& targetCommit, const std::string& outputPath,
-                const std::string& sourceBranch) {
-        std::string basePath = baseCommit.empty() ? "" : PathUtils::joinPath(".vcs", "commits", baseCommit, "data");
-        std::string sourcePath = PathUtils::joinPath(".vcs", "commits", sourceCommit, "data");
-        std::string targetPath = PathUtils::joinPath(".vcs", "commits", targetCommit, "data");
-        std::unordered_set<std::string> allFiles;
-        if (!baseCommit.empty() && PathUtils::exists(basePath)) {
-            for (const auto& file : PathUtils::listRecursiveDirectory(basePath)) {
-                allFiles.insert(file);
-            }
+    // Log positions of a commit's parents; parents missing from the log are skipped
+    std::vector<uint32_t> parentPositions(const Commit& commit) const {
+        std::vector<uint32_t> parents;
+        for (const auto& parentId : commit.parentIds) {
+            uint32_t pos = commitLog.position(parentId);
+            if (pos != CommitLog::NONE) parents.push_back(pos);
         }
-        if (PathUtils::exists(sourcePath)) {
-            for (const auto& file : PathUtils::listRecursiveDirectory(sourcePath)) {
-                allFiles.insert(file);
-            }
+        return parents;
+    }
+    // Name a new commit by its content and add it, unless an identical
+    // commit is already in the log
+    void appendCommit(const std::shared_ptr<Commit>& commit) {
+        commit->id = commit->contentId();
+        if (commitLog.contains(commit->id)) return;
+        std::vector<uint32_t> parents = parentPositions(*commit);
+        if (parents.size() > 2) throw std::runtime_error("Commits with more than two parents are not supported");
+        commitLog.append(*commit);
+        commitGraph.append(parents);
+        cacheCommit(commit);
+    }
+    void cacheCommit(const std::shared_ptr<Commit>& commit) const {
+        commitCache.put(commit->id, commit, commit->files.size() + 1);
+    }
+    // Root tree of a commit; "" if there is no such commit. Commits made
+    // before trees get one built in memory from their file list.
+    std::string rootTree(const std::string& commitId) const {
+        auto commit = commitId.empty() ? nullptr : getCommit(commitId);
+        if (!commit) return "";
+        if (!commit->treeHash.empty()) return commit->treeHash;
+        auto it = legacyRoots.find(commitId);
+        if (it != legacyRoots.end()) return it->second;
+        FileMap files;
+        commit->files.forEach([&](std::string_view path, const Manifest::Entry& entry) {
+            files[std::string(path)] = {entry.hash, entry.mode};
+        });
+        return legacyRoots[commitId] = treeStore.write(files, "", false);
+    }
+    std::string findMergeBase(const std::string& commit1, const std::string& commit2) const {
+        uint32_t pos1 = commitLog.position(commit1);
+        uint32_t pos2 = commitLog.position(commit2);
+        if (pos1 == CommitLog::NONE || pos2 == CommitLog::NONE) return "";
+        uint32_t base = commitGraph.mergeBase(pos1, pos2);
+        return base == CommitGraph::NO_PARENT ? "" : commitLog.id(base);
+    }
+    // Three-way merge of one directory. A side that matches the base, or
+    // both sides matching each other, settles the whole subtree by hash;
+    // only directories changed on both sides are opened.
+    std::string mergeTrees(const std::string& baseHash, const std::string& sourceHash,
+                           const std::string& targetHash, const std::string& sourceBranch,
+                           const std::string& prefix = "") {
+        if (sourceHash == targetHash || sourceHash == baseHash) return targetHash;
+        if (targetHash == baseHash) return sourceHash;
+        auto base = treeStore.read(baseHash);
+        auto source = treeStore.read(sourceHash);
+        auto target = treeStore.read(targetHash);
+        std::set<std::string> names;
+        for (const auto& tree : {base, source, target}) {
+            for (const auto& entry : tree->entries) names.insert(entry.name);
         }
-        if (PathUtils::exists(targetPath)) {
-            for (const auto& file : PathUtils::listRecursiveDirectory(targetPath)) {
-                allFiles.insert(file);
+        Tree merged;
+        for (const auto& name : names) {
+            const TreeEntry* b = base->find(name);
+            const TreeEntry* s = source->find(name);
+            const TreeEntry* t = target->find(name);
+            auto same = [](const TreeEntry* x, const TreeEntry* y) {
+                return x == y || (x && y && x->hash == y->hash && x->mode == y->mode);
+            };
+            if (same(s, t) || same(s, b)) {
+                if (t) merged.entries.push_back(*t);
+            } else if (same(t, b)) {
+                if (s) merged.entries.push_back(*s);
+            } else if (s && t && s->isTree() && t->isTree()) {
+                std::string baseTree = b && b->isTree() ? b->hash.hex() : "";
+                std::string hash = mergeTrees(baseTree, s->hash.hex(), t->hash.hex(), sourceBranch, prefix + name + "/");
+                merged.entries.push_back({name, Tree::TREE_MODE, Digest::fromHex(hash)});
+            } else if (s && t && !s->isTree() && !t->isTree()) {
+                std::string baseFile = b && !b->isTree() ? b->hash.hex() : "";
+                Digest hash = s->hash == t->hash ? t->hash
+                            : Digest::fromHex(mergeFile(prefix + name, baseFile, s->hash.hex(), t->hash.hex(), sourceBranch));
+                merged.entries.push_back({name, t->mode, hash});
+            } else {
+                // Deleted on one side and changed on the other, or a file on
+                // one side and a directory on the other: keep what exists,
+                // preferring the current branch, and report the conflict
+                mergeConflicts.push_back(prefix + name + (s && t ? " (a file on one side, a directory on the other)"
+                                                                 : " (deleted on one side, modified on the other)"));
+                merged.entries.push_back(t ? *t : *s);
             }
         }
-        PathUtils::createDirectory(outputPath);
-        for (const std::string& file : allFiles) {
-            std::string baseFile = baseCommit.empty() ? "" : PathUtils::joinPath(basePath, file);
-            std::string sourceFile = PathUtils::joinPath(sourcePath, file);
-            std::string targetFile = PathUtils::joinPath(targetPath, file);
-            std::string outputFile = PathUtils::joinPath(outputPath, file);
-            bool baseExists = !baseCommit.empty() && PathUtils::exists(baseFile);
-            bool sourceExists = PathUtils::exists(sourceFile);
-            bool targetExists = PathUtils::exists(targetFile);
-            std::string outputDir = getDirectory(outputFile);
-            if (!outputDir.empty()) PathUtils::createDirectory(outputDir);
-            if (!sourceExists && !targetExists) continue;
-            if (sourceExists && !targetExists) { PathUtils::copyFile(sourceFile, outputFile); continue; }
-            if (!sourceExists && targetExists) { PathUtils::copyFile(targetFile, outputFile); continue; }
-            if (areFilesIdentical(sourceFile, targetFile)) { PathUtils::copyFile(sourceFile, outputFile); continue; }
-            if (baseExists) {
-                std::string baseContent = readFileContent(baseFile);
-                std::string sourceContent = readFileContent(sourceFile);
-                std::string targetContent = readFileContent(targetFile);
-                if (sourceContent == baseContent) { PathUtils::copyFile(targetFile, outputFile); }
-                else if (targetContent == baseContent) { PathUtils::copyFile(sourceFile, outputFile); }
-                else { handleConflict(sourceFile, targetFile, outputFile, sourceBranch); }
-            } else { handleConflict(sourceFile, targetFile, outputFile, sourceBranch); }
-        }
-    }
-    void handleConflict(const std::string& sourceFile, const std::string& targetFile,
-                   const std::string& outputFile, const std::string& sourceBranch) {
-        if (!sourceFile.empty() && !targetFile.empty() && areFilesIdentical(sourceFile, targetFile)) {
-            PathUtils::copyFile(sourceFile, outputFile); return;
-        }
-        std::string targetContent = readFileContent(targetFile);
-        std::string sourceContent = readFileContent(sourceFile);
-        if (sourceContent.empty() && !targetContent.empty()) { PathUtils::copyFile(targetFile, outputFile); return; }
-        if (!sourceContent.empty() && targetContent.empty()) { PathUtils::copyFile(sourceFile, outputFile); return; }
-        std::ofstream out(outputFile);
-        bool hasConflict = !sourceContent.empty() && !targetContent.empty() && sourceContent != targetContent;
-        if (hasConflict) {
-            out << "<<<<<<< HEAD\n";
-            out << targetContent;
-            if (!targetContent.empty() && targetContent.back() != '\n') out << '\n';
-            out << "=======\n";
-            out << sourceContent;
-            if (!sourceContent.empty() && sourceContent.back() != '\n') out << '\n';
-            out << ">>>>>>> " << sourceBranch << "\n";
-        } else if (!sourceContent.empty()) {
-            out << sourceContent;
-        } else if (!targetContent.empty()) {
-            out << targetContent;
-        }
-    }
-    void storeCommitFiles(const std::string& commitId, const std::string& sourcePath) {
-        std::string commitPath = PathUtils::joinPath(".vcs", "commits", commitId);
-        PathUtils::createDirectory(commitPath);
-        std::string dataPath = PathUtils::joinPath(commitPath, "data");
-        PathUtils::createDirectory(dataPath);
-        auto files = PathUtils::listRecursiveDirectory(sourcePath);
-        for (const auto& file : files) {
-            std::string srcFile = PathUtils::joinPath(sourcePath, file);
-            std::string destFile = PathUtils::joinPath(dataPath, file + ".huff");
-            std::string compressed = HuffmanCoder::compress(srcFile);
-            std::ofstream out(destFile, std::ios::binary);
-            out << compressed;
-        }
-    }
-    void restoreCommitFiles(const std::string& commitId, const std::string& destPath) {
-        std::string commitPath = PathUtils::joinPath(".vcs", "commits", commitId, "data");
-        auto files = PathUtils::listRecursiveDirectory(commitPath);
-        for (const auto& file : files) {
-            if (file.size() > 5 && file.substr(file.size() - 5) == ".huff") {
-                std::string compressedFile = PathUtils::joinPath(commitPath, file);
-                std::ifstream in(compressedFile, std::ios::binary);
-                std::string compressed((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-                std::string decompressed = HuffmanCoder::decompress(compressed);
-                std::string outFile = PathUtils::joinPath(destPath, file.substr(0, file.size() - 5));
-                std::ofstream out(outFile, std::ios::binary);
-                out << decompressed;
+        return treeStore.store(merged, targetHash);
+    }
+    // Merge the lines of a file changed on both sides and store the result,
+    // with conflict markers around the hunks both sides changed differently.
+    // Binary files cannot be merged by lines; the current branch's version
+    // is kept and reported as a conflict.
+    std::string mergeFile(const std::string& path, const std::string& baseHash, const std::string& sourceHash,
+                          const std::string& targetHash, const std::string& sourceBranch) {
+        std::string base = baseHash.empty() ? "" : objectStore.readObject(baseHash);
+        std::string source = objectStore.readObject(sourceHash);
+        std::string target = objectStore.readObject(targetHash);
+        if (LineDiff::isBinary(base) || LineDiff::isBinary(source) || LineDiff::isBinary(target)) {
+            mergeConflicts.push_back(path);
+            return targetHash;
+        }
+        LineMerge::Result merged = LineMerge::merge(base, target, source, sourceBranch);
+        if (merged.conflicts > 0) mergeConflicts.push_back(path);
+        std::string hash = HashUtils::computeSHA256(merged.text);
+        objectStore.storeData(hash, merged.text, targetHash, path);
+        return hash;
+    }
+    // Write every file of a commit under destPath, recording each one in
+    // index (if given) so the next status does not read it again
+    void restoreCommitFiles(const std::string& commitId, const std::string& destPath, Index* index) {
+        for (const auto& [file, entry] : getCommitFiles(commitId)) {
+            std::string hash = entry.hash.hex();
+            if (!objectStore.hasObject(hash)) {
+                cerr << YEL "Warning: no stored data for '" << file << "' in commit " << commitId << END << endl;
+                continue;
             }
+            std::string destFile = PathUtils::joinPath(destPath, file);
+            if (!objectStore.restoreFile(hash, destFile, &copyStats)) continue;
+            chmod(destFile.c_str(), entry.mode);
+            PathUtils::FileStat stat;
+            if (index && PathUtils::statFile(destFile, stat)) index->record(file, stat, entry.hash);
+        }
+    }
+    // Directories under .vcs/commits that still hold a commit's file data
+    // in the format used before the object store
+    static std::vector<std::string> legacyDataCommits() {
+        std::vector<std::string> ids;
+        std::string commitsPath = PathUtils::joinPath(".vcs", "commits");
+        if (!PathUtils::isDirectory(commitsPath)) return ids;
+        for (const auto& id : PathUtils::listDirectory(commitsPath)) {
+            if (PathUtils::isDirectory(PathUtils::joinPath(commitsPath, id, "data"))) ids.push_back(id);
         }
+        return ids;
     }
 public:
     CommitManager() { loadCommitState(); }
-    ~CommitManager() { saveCommitState(); }
+    // Queue the commits added by this command
+    void flush(RepoTransaction& tx) {
+        commitLog.flush(tx);
+        commitGraph.flush(tx);
+        if (!legacyJsonPath.empty()) tx.remove(legacyJsonPath);
+        legacyJsonPath.clear();
+        for (const auto& dir : legacyDataDirs) tx.remove(dir);
+        legacyDataDirs.clear();
+    }
+    // Record a commit of the staged manifest. Its blobs were stored when the
+    // files were added, so no file data is read here; only directories that
+    // changed since the first parent produce new tree objects.
     std::string createCommit(const std::string& message, const std::string& branch,
-                            const std::vector<std::string>& parents = {}) {
+                             const std::vector<std::string>& parents, const FileMap& manifest) {
         auto commit = std::make_shared<Commit>(message, branch, parents);
-        std::string stagingPath = PathUtils::joinPath(".vcs", "staging_area");
-        auto files = PathUtils::listRecursiveDirectory(stagingPath);
-        for (const auto& file : files) {
-            std::string fullPath = PathUtils::joinPath(stagingPath, file);
-            commit->addFile(file, computeFileHash(fullPath));
-        }
-        storeCommitFiles(commit->id, stagingPath);
-        commits[commit->id] = commit;
-        head = commit->id;
-        saveCommitState();
+        commit->treeHash = treeStore.write(manifest, parents.empty() ? "" : rootTree(parents[0]));
+        appendCommit(commit);
         return commit->id;
     }
+    // True if ancestor is commit itself or one of its ancestors
+    bool isAncestor(const std::string& ancestor, const std::string& commit) const {
+        uint32_t ancestorPos = commitLog.position(ancestor);
+        uint32_t commitPos = commitLog.position(commit);
+        if (ancestorPos == CommitLog::NONE || commitPos == CommitLog::NONE) return false;
+        return commitGraph.isAncestor(ancestorPos, commitPos);
+    }
     bool commitExists(const std::string& commitId) const {
-        return commits.find(commitId) != commits.end();
+        return commitLog.contains(commitId);
     }
     std::shared_ptr<Commit> getCommit(const std::string& commitId) const {
-        auto it = commits.find(commitId);
-        return it != commits.end() ? it->second : nullptr;
+        if (auto* cached = commitCache.get(commitId)) return *cached;
+        auto commit = commitLog.read(commitId);
+        if (commit) cacheCommit(commit);
+        return commit;
+    }
+    // Every file of a commit by path; empty for an unknown commit
+    FileMap getCommitFiles(const std::string& commitId) const {
+        return treeStore.flatten(rootTree(commitId));
+    }
+    ObjectStore::RepackStats repackObjects() {
+        return objectStore.repack();
+    }
+    bool hasLegacyData() const {
+        return !legacyDataCommits().empty();
+    }
+    // Repositories created before the object store kept one compressed copy
+    // of every file per commit under .vcs/commits/<id>/data. Store those
+    // files as objects; each directory is deleted by the next flush, after
+    // the transaction has synced the new objects. Returns the number of
+    // commits whose data was moved.
+    size_t migrateLegacyData() {
+        size_t migrated = 0;
+        for (const auto& id : legacyDataCommits()) {
+            std::string commitPath = PathUtils::joinPath(".vcs", "commits", id);
+            if (std::find(legacyDataDirs.begin(), legacyDataDirs.end(), commitPath) != legacyDataDirs.end()) continue;
+            auto commit = getCommit(id);
+            if (!commit) continue;
+            std::string dataPath = PathUtils::joinPath(commitPath, "data");
+            commit->files.forEach([&](std::string_view file, const Manifest::Entry& entry) {
+                std::string hash = entry.hash.hex();
+                std::string legacyFile = PathUtils::joinPath(dataPath, std::string(file) + ".huff");
+                if (objectStore.hasObject(hash) || !PathUtils::isFile(legacyFile)) return;
+                std::ifstream in(legacyFile, std::ios::binary);
+                std::string compressed((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                objectStore.storeData(hash, HuffmanCoder::decompress(compressed));
+            });
+            legacyDataDirs.push_back(commitPath);
+            ++migrated;
+        }
+        return migrated;
     }
-    std::vector<std::string> getCommitHistory(const std::string& startCommit = "") const {
+    // Every object reachable from the given commits, plus the given blobs
+    // (staged files), in the order gc lays them out: the blobs first, then
+    // commits newest first with each snapshot's trees and files in path
+    // order, every object followed by the delta bases it is stored against.
+    // Trees, and then delta headers, are read a level at a time on all
+    // hardware threads.
+    std::vector<std::string> reachableObjects(const std::vector<std::string>& tips,
+                                              const std::vector<Digest>& blobs) const {
+        std::vector<uint32_t> commits;
+        std::vector<char> seen(commitLog.size());
+        auto visit = [&](uint32_t pos) {
+            if (pos < seen.size() && !seen[pos]) {
+                seen[pos] = 1;
+                commits.push_back(pos);
+            }
+        };
+        for (const auto& tip : tips) visit(commitLog.position(tip));
+        for (size_t i = 0; i < commits.size(); ++i) {
+            for (uint32_t parent : commitGraph.entry(commits[i]).parents) visit(parent);
+        }
+        std::sort(commits.begin(), commits.end(), std::greater<uint32_t>());
+
+        // The walk works on digests; object names are spelled out in hex only
+        // to open objects and for the result
+        std::vector<std::shared_ptr<Commit>> snapshots;
+        std::unordered_map<Digest, std::shared_ptr<const Tree>> trees;
+        std::vector<Digest> frontier;
+        for (uint32_t pos : commits) {
+            snapshots.push_back(commitLog.read(pos));
+            const std::string& root = snapshots.back()->treeHash;
+            if (root.empty()) continue;
+            Digest hash = Digest::fromHex(root);
+            if (trees.emplace(hash, nullptr).second) frontier.push_back(hash);
+        }
+        ThreadPool& pool = ThreadPool::shared();
+        while (!frontier.empty()) {
+            std::vector<std::shared_ptr<const Tree>> level(frontier.size());
+            pool.parallelFor(frontier.size(), [&](size_t i) {
+                level[i] = std::make_shared<const Tree>(Tree::decode(objectStore.readObject(frontier[i].hex())));
+            });
+            std::vector<Digest> next;
+            for (size_t i = 0; i < frontier.size(); ++i) {
+                trees[frontier[i]] = level[i];
+                for (const auto& entry : level[i]->entries) {
+                    if (entry.isTree() && trees.emplace(entry.hash, nullptr).second) next.push_back(entry.hash);
+                }
+            }
+            frontier = std::move(next);
+        }
+
+        std::vector<Digest> order;
+        std::unordered_set<Digest> known;
+        auto emit = [&](const Digest& hash) {
+            if (known.insert(hash).second) order.push_back(hash);
+        };
+        std::function<void(const Digest&)> emitTree = [&](const Digest& hash) {
+            if (!known.insert(hash).second) return;
+            order.push_back(hash);
+            for (const auto& entry : trees.at(hash)->entries) {
+                if (entry.isTree()) emitTree(entry.hash);
+                else emit(entry.hash);
+            }
+        };
+        for (const auto& blob : blobs) emit(blob);
+        for (const auto& commit : snapshots) {
+            if (!commit->treeHash.empty()) emitTree(Digest::fromHex(commit->treeHash));
+            commit->files.forEach([&](std::string_view, const Manifest::Entry& entry) { emit(entry.hash); });
+        }
+
+        std::unordered_map<Digest, Digest> baseOf;
+        std::vector<Digest> pending = order;
+        while (!pending.empty()) {
+            std::vector<std::optional<Digest>> bases(pending.size());
+            pool.parallelFor(pending.size(), [&](size_t i) {
+                std::string name = pending[i].hex();
+                std::string base = objectStore.hasObject(name) ? objectStore.deltaBase(name) : "";
+                if (!base.empty()) bases[i] = Digest::fromHex(base);
+            });
+            std::vector<Digest> next;
+            for (size_t i = 0; i < pending.size(); ++i) {
+                if (!bases[i]) continue;
+                baseOf[pending[i]] = *bases[i];
+                if (known.insert(*bases[i]).second) next.push_back(*bases[i]);
+            }
+            pending = std::move(next);
+        }
+        std::vector<std::string> laidOut;
+        std::unordered_set<Digest> placed;
+        for (const auto& hash : order) {
+            for (const Digest* next = &hash; next && placed.insert(*next).second;) {
+                laidOut.push_back(next->hex());
+                auto base = baseOf.find(*next);
+                next = base != baseOf.end() ? &base->second : nullptr;
+            }
+        }
+        return laidOut;
+    }
+    ObjectStore::GcStats collectGarbage(const std::vector<std::string>& reachable, int64_t keepSince) {
+        return objectStore.collectGarbage(reachable, keepSince);
+    }
+    // First-parent history from a commit, newest first, read from the commit graph
+    std::vector<std::string> getCommitHistory(const std::string& startCommit) const {
         std::vector<std::string> history;
-        std::string current = startCommit.empty() ? head : startCommit;
-        while (!current.empty()) {
-            history.push_back(current);
-            auto commit = getCommit(current);
-            if (!commit || commit->parentIds.empty()) break;
-            current = commit->parentIds[0];
+        uint32_t pos = commitLog.position(startCommit);
+        if (pos == CommitLog::NONE) return history;
+        for (; pos != CommitGraph::NO_PARENT; pos = commitGraph.entry(pos).parents[0]) {
+            history.push_back(commitLog.id(pos));
         }
         return history;
     }
-    bool restoreCommit(const std::string& commitId, const std::string& targetPath) {
-        auto commit = getCommit(commitId);
-        if (!commit) return false;
-
-        std::string commitPath = PathUtils::joinPath(".vcs", "commits", commitId, "data");
-        return PathUtils::copyDirectory(commitPath, targetPath);
+    bool restoreCommit(const std::string& commitId, const std::string& targetPath, Index* index = nullptr) {
+        if (!commitExists(commitId)) return false;
+        restoreCommitFiles(commitId, targetPath, index);
+        return true;
+    }
+    // A path whose contents or mode differ between two commits; a hash is
+    // unset on the side where the path does not exist
+    struct FileChange {
+        std::string path;
+        std::optional<Digest> fromHash;
+        std::optional<Digest> toHash;
+        uint32_t fromMode = Commit::DEFAULT_MODE;
+        uint32_t toMode = Commit::DEFAULT_MODE;
+    };
+    // Paths that differ between two commits, sorted. An empty or unknown
+    // commit id stands for an empty tree. Directories with the same tree
+    // hash on both sides are not read.
+    std::vector<FileChange> diffCommits(const std::string& fromId, const std::string& toId) const {
+        std::vector<FileChange> changes;
+        treeStore.diff(rootTree(fromId), rootTree(toId),
+                       [&](const std::string& path, const TreeEntry* from, const TreeEntry* to) {
+            changes.push_back({path, from ? std::optional<Digest>(from->hash) : std::nullopt,
+                               to ? std::optional<Digest>(to->hash) : std::nullopt,
+                               from ? from->mode : Commit::DEFAULT_MODE, to ? to->mode : Commit::DEFAULT_MODE});
+        });
+        std::sort(changes.begin(), changes.end(),
+                  [](const FileChange& a, const FileChange& b) { return a.path < b.path; });
+        return changes;
+    }
+    // Hash and store files (relative to root) unless their blobs exist.
+    // Each file is read once by one of `jobs` workers (0: one per hardware
+    // thread), which hashes it, compresses it and writes its blob. Changed
+    // files are offered their version in base as a delta base. Returns the
+    // hashes in the order of files.
+    std::vector<Digest> storeFiles(const std::string& root, const std::vector<std::string>& files,
+                                   const FileMap* base, size_t jobs) {
+        std::vector<Digest> hashes(files.size());
+        std::unique_ptr<ThreadPool> ownPool;
+        if (jobs > 0) ownPool = std::make_unique<ThreadPool>(jobs);
+        ThreadPool& pool = ownPool ? *ownPool : ThreadPool::shared();
+        std::mutex statsMutex;
+        pool.parallelFor(files.size(), [&](size_t i) {
+            std::string baseHash;
+            if (base) {
+                auto it = base->find(files[i]);
+                if (it != base->end()) baseHash = it->second.hash.hex();
+            }
+            FileCopy::Stats stats;
+            std::string hash = objectStore.storeFile(PathUtils::joinPath(root, files[i]), baseHash, &stats);
+            if (hash.empty()) throw std::runtime_error("Could not store file: " + files[i]);
+            hashes[i] = Digest::fromHex(hash);
+            if (!stats.empty()) {
+                std::lock_guard<std::mutex> lock(statsMutex);
+                copyStats.add(stats);
+            }
+        });
+        return hashes;
+    }
+    // Blobs by digest; the object store names them in hex
+    bool hasObject(const Digest& hash) const {
+        return objectStore.hasObject(hash.hex());
+    }
+    std::string readObject(const Digest& hash) const {
+        return objectStore.readObject(hash.hex());
+    }
+    bool isChunkedObject(const Digest& hash) const {
+        return objectStore.isChunked(hash.hex());
+    }
+    bool restoreFile(const Digest& hash, const std::string& destFile, uint32_t mode = Commit::DEFAULT_MODE) {
+        if (!objectStore.restoreFile(hash.hex(), destFile, &copyStats)) return false;
+        return chmod(destFile.c_str(), mode) == 0;
+    }
+    // How file data was copied by the commits and restores since the last
+    // call, for reporting
+    FileCopy::Stats takeCopyStats() {
+        FileCopy::Stats stats = copyStats;
+        copyStats = FileCopy::Stats();
+        return stats;
+    }
+    // Paths merged with conflicts since the last call, for reporting
+    std::vector<std::string> takeMergeConflicts() {
+        std::vector<std::string> conflicts;
+        conflicts.swap(mergeConflicts);
+        std::sort(conflicts.begin(), conflicts.end());
+        return conflicts;
     }
     std::string createMergeCommit(const std::string& message, const std::string& branch,
+                                 const std::string& sourceBranch,
                                  const std::string& sourceBranchCommit, 
                                  const std::string& targetBranchCommit) {
         std::string mergeBase = findMergeBase(sourceBranchCommit, targetBranchCommit);
-        std::string tempDir = PathUtils::joinPath(".vcs", "merge_temp");
-        if (PathUtils::exists(tempDir)) {
-            PathUtils::removeDirectory(tempDir);
-        }
-        PathUtils::createDirectory(tempDir);
-        std::string sourceBranch = message.substr(message.find("'") + 1);
-        sourceBranch = sourceBranch.substr(0, sourceBranch.find("'"));
-        mergeFiles(mergeBase, sourceBranchCommit, targetBranchCommit, tempDir, sourceBranch);
         auto commit = std::make_shared<Commit>(message, branch, 
             std::vector<std::string>{targetBranchCommit, sourceBranchCommit});
-        std::string commitPath = PathUtils::joinPath(".vcs", "commits", commit->id);
-        PathUtils::createDirectory(commitPath);
-        PathUtils::copyDirectory(tempDir, PathUtils::joinPath(commitPath, "data"));
-        PathUtils::removeDirectory(tempDir);
-        commits[commit->id] = commit;
-        head = commit->id;
-        saveCommitState();
+        commit->treeHash = mergeTrees(rootTree(mergeBase), rootTree(sourceBranchCommit),
+                                      rootTree(targetBranchCommit), sourceBranch);
+        treeStore.persist(commit->treeHash);
+        appendCommit(commit);
         return commit->id;
     }
-    bool areFilesIdentical(const std::string& file1, const std::string& file2) {
-        return computeFileHash(file1) == computeFileHash(file2);
-    }
-    std::string readFileContent(const std::string& filePath) {
-        if (!PathUtils::exists(filePath)) return "";
-        std::ifstream file(filePath);
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        return buffer.str();
-    }
 };
\ No newline at end of file
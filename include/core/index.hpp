@@ -0,0 +1,250 @@
+#pragma once
+#include "../utils/pathUtils.hpp"
+#include "../utils/hashUtils.hpp"
+#include "../utils/binaryIO.hpp"
+#include "../models/tree.hpp"
+#include "repoTransaction.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <optional>
+#include <cstring>
+
+// Stat cache and staging manifest for the repository, stored in .vcs/index:
+//
+//   "VNDX" | version u32 | count u32 | entries sorted by path
+//          | staged count u32 | staged entries sorted by path
+//   entry: path length varint | path | size u64 | mtime ns u64 | inode u64 | hash[32]
+//   staged entry: path length varint | path | mode u32 | hash[32]
+//
+// A cached hash is reused while the file's size, mtime and inode still match
+// its entry, so unchanged files are never read. An entry whose mtime is not
+// older than the index file itself is rehashed anyway: the file may have been
+// modified again within the same timestamp tick after it was recorded.
+//
+// Staged entries are what `vcs add` recorded for the next commit; their blobs
+// are already in the object store. Version 1 files have no staged section.
+class Index {
+public:
+    static constexpr uint32_t VERSION = 2;
+    static constexpr size_t HASH_SIZE = Digest::SIZE;
+
+    struct Entry {
+        PathUtils::FileStat stat;
+        Digest hash;       // digest of the contents
+        bool seen = false; // looked up since the index was loaded
+    };
+
+    using StagedEntry = FileEntry;
+
+private:
+    std::string indexPath;
+    std::unordered_map<std::string, Entry> entries;
+    FileMap staged;
+    uint64_t indexMtimeNs = 0;
+    std::string loadedData;  // the index file as read, "" if there was none
+    bool dirty = false;
+
+    static bool sameStat(const PathUtils::FileStat& a, const PathUtils::FileStat& b) {
+        return a.size == b.size && a.mtimeNs == b.mtimeNs && a.inode == b.inode;
+    }
+
+    static std::string readPath(const unsigned char*& p, const unsigned char* end, size_t fixedBytes) {
+        uint64_t length = BinaryIO::getVarint(p, end);
+        if (length > static_cast<uint64_t>(end - p) || static_cast<uint64_t>(end - p) - length < fixedBytes) {
+            throw std::runtime_error("Truncated index");
+        }
+        std::string path(reinterpret_cast<const char*>(p), length);
+        p += length;
+        return path;
+    }
+
+    template <typename Map>
+    static std::vector<const typename Map::value_type*> sortedByPath(const Map& map) {
+        std::vector<const typename Map::value_type*> sorted;
+        sorted.reserve(map.size());
+        for (const auto& item : map) sorted.push_back(&item);
+        std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+        return sorted;
+    }
+
+    void load() {
+        PathUtils::FileStat indexStat;
+        if (!PathUtils::statFile(indexPath, indexStat)) return;
+        indexMtimeNs = indexStat.mtimeNs;
+        std::ifstream in(indexPath, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        loadedData = data;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+        const unsigned char* end = p + data.size();
+        uint32_t version = data.size() >= 12 ? BinaryIO::getU32(p + 4) : 0;
+        if (data.size() < 12 || data.compare(0, 4, "VNDX") != 0 || version < 1 || version > VERSION) {
+            dirty = true;  // unreadable: rebuild it from scratch
+            return;
+        }
+        uint32_t count = BinaryIO::getU32(p + 8);
+        p += 12;
+        entries.reserve(count);
+        try {
+            for (uint32_t i = 0; i < count; ++i) {
+                std::string path = readPath(p, end, 24 + HASH_SIZE);
+                Entry entry;
+                entry.stat.size = BinaryIO::getU64(p);
+                entry.stat.mtimeNs = BinaryIO::getU64(p + 8);
+                entry.stat.inode = BinaryIO::getU64(p + 16);
+                std::memcpy(entry.hash.bytes.data(), p + 24, HASH_SIZE);
+                p += 24 + HASH_SIZE;
+                entries.emplace(std::move(path), std::move(entry));
+            }
+            if (version >= 2) {
+                if (end - p < 4) throw std::runtime_error("Truncated index");
+                uint32_t stagedCount = BinaryIO::getU32(p);
+                p += 4;
+                for (uint32_t i = 0; i < stagedCount; ++i) {
+                    std::string path = readPath(p, end, 4 + HASH_SIZE);
+                    StagedEntry entry;
+                    entry.mode = BinaryIO::getU32(p);
+                    std::memcpy(entry.hash.bytes.data(), p + 4, HASH_SIZE);
+                    p += 4 + HASH_SIZE;
+                    staged.emplace(std::move(path), std::move(entry));
+                }
+            } else {
+                dirty = true;  // rewrite in the current format
+            }
+        } catch (const std::runtime_error&) {
+            if (version < 2) {
+                entries.clear();
+                dirty = true;
+                return;
+            }
+            // The stat cache can be rebuilt, but losing staged changes silently
+            // would be worse than refusing to go on
+            throw std::runtime_error("Corrupt index file: " + indexPath);
+        }
+    }
+
+public:
+    Index() : indexPath(PathUtils::joinPath(".vcs", "index")) { load(); }
+
+    // Content hash of a file, taken from the cache when its stat data is
+    // unchanged and recomputed (and recorded) otherwise. Returns nullopt if
+    // the file cannot be read.
+    std::optional<Digest> hashFile(const std::string& path) {
+        PathUtils::FileStat current;
+        if (!PathUtils::statFile(path, current)) return std::nullopt;
+        if (auto hash = cachedHash(path, current)) return hash;
+        auto digest = HashUtils::computeFileDigest(path);
+        if (digest) record(path, current, *digest);
+        return digest;
+    }
+
+    // hashFile for many files; the ones that have to be read are hashed
+    // concurrently. Result i belongs to paths[i].
+    std::vector<std::optional<Digest>> hashFiles(const std::vector<std::string>& paths,
+                                                 ThreadPool& pool = ThreadPool::shared()) {
+        std::vector<std::optional<Digest>> hashes(paths.size());
+        std::vector<PathUtils::FileStat> stats(paths.size());
+        std::vector<std::string> toRead;
+        std::vector<size_t> readSlots;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (!PathUtils::statFile(paths[i], stats[i])) continue;
+            hashes[i] = cachedHash(paths[i], stats[i]);
+            if (!hashes[i]) {
+                toRead.push_back(paths[i]);
+                readSlots.push_back(i);
+            }
+        }
+        auto digests = HashUtils::computeFileDigests(toRead, pool);
+        for (size_t k = 0; k < digests.size(); ++k) {
+            if (!digests[k]) continue;
+            size_t i = readSlots[k];
+            record(paths[i], stats[i], *digests[k]);
+            hashes[i] = digests[k];
+        }
+        return hashes;
+    }
+
+    // Cached hash for a file whose stat data is current, or nullopt if the
+    // file has to be read
+    std::optional<Digest> cachedHash(const std::string& path, const PathUtils::FileStat& current) {
+        auto it = entries.find(path);
+        if (it == entries.end()) return std::nullopt;
+        it->second.seen = true;
+        if (sameStat(it->second.stat, current) && it->second.stat.mtimeNs < indexMtimeNs) {
+            return it->second.hash;
+        }
+        return std::nullopt;
+    }
+
+    // Remember the hash of a file read with the given stat data. The stat
+    // must be taken before reading, so a concurrent write is caught later.
+    void record(const std::string& path, const PathUtils::FileStat& stat, const Digest& hash) {
+        Entry& entry = entries[path];
+        entry.stat = stat;
+        entry.hash = hash;
+        entry.seen = true;
+        dirty = true;
+    }
+
+    // Drop the entry for a file that no longer exists
+    void forget(const std::string& path) {
+        if (entries.erase(path)) dirty = true;
+    }
+
+    // Drop entries that were not looked up since the index was loaded
+    void pruneUnseen() {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.seen) {
+                ++it;
+            } else {
+                it = entries.erase(it);
+                dirty = true;
+            }
+        }
+    }
+
+    size_t size() const { return entries.size(); }
+
+    void stage(const std::string& path, const Digest& hash, uint32_t mode) {
+        StagedEntry& entry = staged[path];
+        if (entry.hash == hash && entry.mode == mode) return;
+        entry.hash = hash;
+        entry.mode = mode;
+        dirty = true;
+    }
+
+    const FileMap& stagedEntries() const { return staged; }
+
+    void clearStaged() {
+        if (staged.empty()) return;
+        staged.clear();
+        dirty = true;
+    }
+
+    // Queue a rewrite of the index if anything changed. With
+    // ifUnchanged, the rewrite fails if another process has replaced the
+    // index since it was loaded, rather than overwriting what it staged.
+    void flush(RepoTransaction& tx, bool ifUnchanged = false) {
+        if (!dirty) return;
+        std::string data = "VNDX";
+        BinaryIO::putU32(data, VERSION);
+        BinaryIO::putU32(data, static_cast<uint32_t>(entries.size()));
+        for (const auto* item : sortedByPath(entries)) {
+            BinaryIO::putVarint(data, item->first.size());
+            data += item->first;
+            BinaryIO::putU64(data, item->second.stat.size);
+            BinaryIO::putU64(data, item->second.stat.mtimeNs);
+            BinaryIO::putU64(data, item->second.stat.inode);
+            data.append(reinterpret_cast<const char*>(item->second.hash.data()), HASH_SIZE);
+        }
+        BinaryIO::putU32(data, static_cast<uint32_t>(staged.size()));
+        for (const auto* item : sortedByPath(staged)) {
+            BinaryIO::putVarint(data, item->first.size());
+            data += item->first;
+            BinaryIO::putU32(data, item->second.mode);
+            data.append(reinterpret_cast<const char*>(item->second.hash.data()), HASH_SIZE);
+        }
+        if (ifUnchanged) tx.replace(indexPath, std::move(data), loadedData);
+        else tx.replace(indexPath, std::move(data));
+        dirty = false;
+    }
+};
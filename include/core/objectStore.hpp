@@ -0,0 +1,796 @@
+#pragma once
+#include "../utils/pathUtils.hpp"
+#include "../utils/hashUtils.hpp"
+#include "../utils/huffmanCoder.hpp"
+#include "../utils/codec.hpp"
+#include "../utils/deltaCoder.hpp"
+#include "../utils/lruCache.hpp"
+#include "../utils/threadPool.hpp"
+#include "../utils/fileCopy.hpp"
+#include "../common.hpp"
+#include "packFile.hpp"
+#include "repoConfig.hpp"
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// Content-addressed blob store under .vcs/objects, keyed by the SHA-256 of the
+// uncompressed file contents. A blob is written once and shared by every
+// commit that references the same contents.
+//
+// New blobs are written loose (.vcs/objects/<hash>); `repack` folds them into
+// pack files under .vcs/objects/pack. Reads look in both.
+//
+// A blob is either a full copy of the contents or a delta against an earlier
+// version of the same path:
+//   "VOBJ" | codec id u8 | codec payload
+//   "VDLT" | depth u8 | base hash[32] | Huffman-coded DeltaCoder stream
+// The codec for full copies comes from .vcs/config (see RepoConfig); blobs
+// without a header are Huffman streams written by older versions.
+//
+// Files above the configured big-file threshold are never loaded whole. They
+// are compressed chunk by chunk, each chunk with its own codec, and restored
+// the same way, so memory use stays bounded by STREAM_CHUNK_SIZE:
+//   "VSTR" | chunk size varint | chunks... | 0 varint
+//   chunk: raw length varint | codec id u8 | payload length varint | payload
+// Large blobs that do not compress are kept raw, with the contents starting
+// on a RAW_ALIGNMENT boundary so that copy-on-write filesystems can reflink
+// them into and out of the store instead of copying:
+//   "VRAW" | zero padding up to RAW_ALIGNMENT | contents
+// Chains are limited to MAX_DELTA_DEPTH so a read reconstructs at most that
+// many bases, and reconstructed bases are kept in an LRU cache.
+//
+// All const methods may be called from several threads at once.
+class ObjectStore {
+public:
+    static constexpr unsigned MAX_DELTA_DEPTH = 10;
+    static constexpr size_t MAX_DELTA_SIZE = 256 * 1024 * 1024;
+    static constexpr size_t BASE_CACHE_BYTES = 64 * 1024 * 1024;
+    static constexpr size_t STREAM_CHUNK_SIZE = 1024 * 1024;
+    static constexpr size_t STREAM_BATCH = 8;  // chunks compressed in parallel
+    static constexpr size_t RAW_ALIGNMENT = 4096;
+    static constexpr size_t RAW_MIN_SIZE = 1024 * 1024;  // smaller blobs are not worth the padding
+
+    struct RepackStats {
+        size_t objects = 0;
+        uint64_t looseBytes = 0;
+        uint64_t packBytes = 0;
+    };
+
+    struct GcStats {
+        size_t packed = 0;    // reachable objects written to the new pack
+        size_t loose = 0;     // reachable objects left loose (big or raw)
+        size_t recent = 0;    // unreachable objects kept for the grace period
+        size_t removed = 0;   // unreachable objects deleted
+        uint64_t bytesBefore = 0;
+        uint64_t bytesAfter = 0;
+    };
+
+private:
+    std::string objectsPath;
+    mutable std::vector<std::unique_ptr<PackFile>> packs;
+    mutable bool packsLoaded = false;
+    mutable RepoConfig config;
+    mutable bool configLoaded = false;
+    mutable LruCache<std::string, std::shared_ptr<const std::string>> baseCache{BASE_CACHE_BYTES};
+    mutable std::mutex stateMutex;  // guards packs and config while they load
+    mutable std::mutex cacheMutex;
+
+    // Sequential reader over the encoded bytes of one object, from a loose
+    // file or from a pack mapping
+    class EncodedReader {
+    private:
+        std::ifstream file;
+        const char* memory = nullptr;
+        size_t memorySize = 0;
+        size_t memoryPos = 0;
+
+    public:
+        explicit EncodedReader(const std::string& path) : file(path, std::ios::binary) {
+            file.seekg(0, std::ios::end);
+            memorySize = static_cast<size_t>(file.tellg());
+            file.seekg(0);
+        }
+        EncodedReader(const char* data, size_t size) : memory(data), memorySize(size) {}
+
+        size_t size() const { return memorySize; }
+
+        void read(char* dst, size_t n) {
+            if (memory) {
+                if (n > memorySize - memoryPos) throw std::runtime_error("Truncated object");
+                std::memcpy(dst, memory + memoryPos, n);
+                memoryPos += n;
+                return;
+            }
+            file.read(dst, n);
+            if (static_cast<size_t>(file.gcount()) != n) throw std::runtime_error("Truncated object");
+        }
+
+        void skip(uint64_t n) {
+            if (memory) {
+                if (n > memorySize - memoryPos) throw std::runtime_error("Truncated object");
+                memoryPos += n;
+                return;
+            }
+            file.seekg(static_cast<std::streamoff>(n), std::ios::cur);
+            if (!file) throw std::runtime_error("Truncated object");
+        }
+
+        uint64_t readVarint() {
+            uint64_t value = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7) {
+                char c;
+                read(&c, 1);
+                value |= static_cast<uint64_t>(c & 0x7f) << shift;
+                if (!(c & 0x80)) return value;
+            }
+            throw std::runtime_error("Corrupt varint");
+        }
+    };
+
+    const RepoConfig& getConfig() const {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!configLoaded) {
+            config = RepoConfig::load();
+            configLoaded = true;
+        }
+        return config;
+    }
+
+    std::shared_ptr<const std::string> cachedBase(const std::string& hash) const {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto cached = baseCache.get(hash);
+        return cached ? *cached : nullptr;
+    }
+
+    void cacheBase(const std::string& hash, const std::shared_ptr<const std::string>& base) const {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        baseCache.put(hash, base, base->size());
+    }
+
+    static constexpr size_t DELTA_HEADER_SIZE = 4 + 1 + PackFile::HASH_SIZE;
+    static constexpr size_t FULL_HEADER_SIZE = 4 + 1;
+
+    static bool hasCodecHeader(const std::string& encoded) {
+        return encoded.size() >= FULL_HEADER_SIZE && encoded.compare(0, 4, "VOBJ") == 0;
+    }
+
+    static bool isStream(const std::string& encoded) {
+        return encoded.size() >= 4 && encoded.compare(0, 4, "VSTR") == 0;
+    }
+
+    static bool isRaw(const std::string& encoded) {
+        return encoded.size() >= 4 && encoded.compare(0, 4, "VRAW") == 0;
+    }
+
+    static std::string rawHeader() {
+        std::string header(RAW_ALIGNMENT, '\0');
+        header.replace(0, 4, "VRAW");
+        return header;
+    }
+
+    // Compress data with the named codec ("auto" or a codec name), falling
+    // back to raw storage when the codec does not make it smaller
+    static const Codec& compressWith(const std::string& data, const std::string& codecName,
+                                     std::string& payload) {
+        const Codec* codec = &Codecs::choose(data, codecName);
+        payload = codec->encode(data);
+        if (codec->id() != CodecId::Stored && payload.size() >= data.size()) {
+            codec = &Codecs::get(CodecId::Stored);
+            payload = data;
+        }
+        return *codec;
+    }
+
+    std::string encodeFull(const std::string& data, const std::string& path) const {
+        std::string payload;
+        const Codec& codec = compressWith(data, getConfig().codecFor(path), payload);
+        if (codec.id() == CodecId::Stored && data.size() >= RAW_MIN_SIZE) return rawHeader() + data;
+        std::string encoded = "VOBJ";
+        encoded += static_cast<char>(codec.id());
+        encoded += payload;
+        return encoded;
+    }
+
+    static std::string decodeFull(const std::string& encoded) {
+        if (isStream(encoded)) {
+            EncodedReader reader(encoded.data(), encoded.size());
+            std::string data;
+            readStream(reader, 0, UINT64_MAX, [&](const std::string& chunk) { data += chunk; });
+            return data;
+        }
+        if (isRaw(encoded)) {
+            if (encoded.size() < RAW_ALIGNMENT) throw std::runtime_error("Truncated object");
+            return encoded.substr(RAW_ALIGNMENT);
+        }
+        if (!hasCodecHeader(encoded)) return HuffmanCoder::decompress(encoded);
+        return Codecs::get(static_cast<uint8_t>(encoded[4])).decode(encoded.substr(FULL_HEADER_SIZE));
+    }
+
+    // Decode the chunks of a "VSTR" object that overlap [offset, offset +
+    // length) and pass the overlapping bytes to sink in order. Chunks outside
+    // the range are skipped without decoding.
+    template <typename Sink>
+    static void readStream(EncodedReader& reader, uint64_t offset, uint64_t length, Sink sink) {
+        char magic[4];
+        reader.read(magic, 4);
+        uint64_t chunkSize = reader.readVarint();
+        uint64_t end = length > UINT64_MAX - offset ? UINT64_MAX : offset + length;
+        uint64_t position = 0;
+        std::string payload;
+        for (uint64_t rawLength; (rawLength = reader.readVarint()) != 0 && position < end;
+             position += rawLength) {
+            char codecId;
+            reader.read(&codecId, 1);
+            uint64_t payloadLength = reader.readVarint();
+            if (rawLength > chunkSize || payloadLength > rawLength) {
+                throw std::runtime_error("Corrupt stream object");
+            }
+            if (position + rawLength <= offset) {
+                reader.skip(payloadLength);
+                continue;
+            }
+            payload.resize(payloadLength);
+            reader.read(&payload[0], payloadLength);
+            std::string chunk = Codecs::get(static_cast<uint8_t>(codecId)).decode(payload);
+            if (chunk.size() != rawLength) throw std::runtime_error("Corrupt stream object");
+            uint64_t from = offset > position ? offset - position : 0;
+            uint64_t to = std::min<uint64_t>(rawLength, end - position);
+            sink(from == 0 && to == rawLength ? chunk : chunk.substr(from, to - from));
+        }
+    }
+
+    // Open a sequential reader over the encoded bytes of an object
+    std::unique_ptr<EncodedReader> openEncoded(const std::string& hash) const {
+        if (hasLooseObject(hash)) return std::make_unique<EncodedReader>(getObjectPath(hash));
+        loadPacks();
+        for (const auto& pack : packs) {
+            long pos = pack->find(hash);
+            if (pos >= 0) {
+                auto [data, length] = pack->slice(static_cast<uint32_t>(pos));
+                return std::make_unique<EncodedReader>(data, length);
+            }
+        }
+        throw std::runtime_error("Missing object: " + hash);
+    }
+
+    // Hash a file and compress it into a "VSTR" object in the same pass,
+    // holding at most STREAM_BATCH chunks in memory at a time. Returns the
+    // content hash, or "" on failure.
+    std::string writeStreamObject(const std::string& filePath, FileCopy::Stats& copyStats) const {
+        std::ifstream in(filePath, std::ios::binary);
+        if (!in) return "";
+        std::string codecName = getConfig().codecFor(filePath);
+        // Decide from the first chunk whether the file is worth compressing
+        std::string first(STREAM_CHUNK_SIZE, '\0');
+        in.read(&first[0], STREAM_CHUNK_SIZE);
+        first.resize(in.gcount());
+        if (Codecs::choose(first, codecName).id() == CodecId::Stored) {
+            return writeRawObject(filePath, copyStats);
+        }
+        in.clear();
+        in.seekg(0);
+        PathUtils::createDirectories(objectsPath);
+        std::string tmpPath = PathUtils::joinPath(objectsPath, "tmp_" + HashUtils::generateId());
+        std::ofstream out(tmpPath, std::ios::binary);
+        std::string header = "VSTR";
+        BinaryIO::putVarint(header, STREAM_CHUNK_SIZE);
+        out << header;
+
+        ThreadPool& pool = ThreadPool::shared();
+        size_t batch = std::max<size_t>(1, std::min(pool.size(), STREAM_BATCH));
+        std::vector<std::string> raw(batch);
+        std::vector<std::string> encoded(batch);
+        Sha256Stream sha;
+        bool done = false;
+        while (!done && out) {
+            size_t filled = 0;
+            for (; filled < batch; ++filled) {
+                raw[filled].resize(STREAM_CHUNK_SIZE);
+                in.read(&raw[filled][0], STREAM_CHUNK_SIZE);
+                raw[filled].resize(in.gcount());
+                if (raw[filled].empty()) {
+                    done = true;
+                    break;
+                }
+                sha.update(raw[filled].data(), raw[filled].size());
+            }
+            pool.parallelFor(filled, [&](size_t i) {
+                std::string payload;
+                const Codec& codec = compressWith(raw[i], codecName, payload);
+                encoded[i].clear();
+                BinaryIO::putVarint(encoded[i], raw[i].size());
+                encoded[i] += static_cast<char>(codec.id());
+                BinaryIO::putVarint(encoded[i], payload.size());
+                encoded[i] += payload;
+            });
+            for (size_t i = 0; i < filled; ++i) out << encoded[i];
+        }
+        std::string terminator;
+        BinaryIO::putVarint(terminator, 0);
+        out << terminator;
+        out.close();
+        std::string hash = sha.hexDigest();
+        if (!out || in.bad()) {
+            PathUtils::removeFile(tmpPath);
+            return "";
+        }
+        if (hasObject(hash)) {
+            PathUtils::removeFile(tmpPath);
+        } else if (std::rename(tmpPath.c_str(), getObjectPath(hash).c_str()) != 0) {
+            PathUtils::removeFile(tmpPath);
+            return "";
+        }
+        return hash;
+    }
+
+    // Store a file as a "VRAW" object. The contents are copied (or reflinked)
+    // after the aligned header first and hashed from the copy, so the hash
+    // always matches what was stored even if the file changes meanwhile.
+    std::string writeRawObject(const std::string& filePath, FileCopy::Stats& copyStats) const {
+        PathUtils::createDirectories(objectsPath);
+        std::string tmpPath = PathUtils::joinPath(objectsPath, "tmp_" + HashUtils::generateId());
+        {
+            std::ofstream out(tmpPath, std::ios::binary);
+            out << rawHeader();
+            if (!out) {
+                PathUtils::removeFile(tmpPath);
+                return "";
+            }
+        }
+        FileCopy::Stats stats;
+        if (!FileCopy::copyRange(filePath, 0, PathUtils::getFileSize(filePath), tmpPath, RAW_ALIGNMENT, stats)) {
+            PathUtils::removeFile(tmpPath);
+            return "";
+        }
+        Sha256Stream sha;
+        std::ifstream in(tmpPath, std::ios::binary);
+        in.seekg(RAW_ALIGNMENT);
+        std::vector<char> buffer(STREAM_CHUNK_SIZE);
+        while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0) {
+            sha.update(buffer.data(), static_cast<size_t>(in.gcount()));
+        }
+        in.close();
+        std::string hash = sha.hexDigest();
+        if (hasObject(hash)) {
+            PathUtils::removeFile(tmpPath);
+            return hash;
+        }
+        if (std::rename(tmpPath.c_str(), getObjectPath(hash).c_str()) != 0) {
+            PathUtils::removeFile(tmpPath);
+            return "";
+        }
+        copyStats.add(stats);
+        return hash;
+    }
+
+    static bool isDelta(const std::string& encoded) {
+        return encoded.size() >= DELTA_HEADER_SIZE && encoded.compare(0, 4, "VDLT") == 0;
+    }
+
+    // Encode data as a delta against baseHash, or return "" when that is not
+    // possible or not worth it
+    std::string encodeDelta(const std::string& data, const std::string& baseHash) const {
+        if (data.size() > MAX_DELTA_SIZE || !hasObject(baseHash)) return "";
+        std::string header = peekEncoded(baseHash, DELTA_HEADER_SIZE);
+        if (isStream(header) || isRaw(header)) return "";
+        unsigned depth = (isDelta(header) ? static_cast<unsigned char>(header[4]) : 0) + 1;
+        if (depth > MAX_DELTA_DEPTH) return "";
+        auto base = resolve(baseHash);
+        if (base->size() > MAX_DELTA_SIZE) return "";
+        cacheBase(baseHash, base);
+        std::string delta = DeltaCoder::encode(*base, data);
+        if (delta.size() >= data.size() / 2) return "";
+        std::string encoded = "VDLT";
+        encoded += static_cast<char>(depth);
+        encoded += HashUtils::hexToBinary(baseHash);
+        encoded += HuffmanCoder::compressData(delta);
+        return encoded;
+    }
+
+    // Reconstruct the contents of an object, following delta chains
+    std::shared_ptr<const std::string> resolve(const std::string& hash) const {
+        if (auto cached = cachedBase(hash)) return cached;
+        std::string encoded = readEncoded(hash);
+        if (!isDelta(encoded)) {
+            return std::make_shared<const std::string>(decodeFull(encoded));
+        }
+        std::string baseHash = HashUtils::binaryToHex(
+            reinterpret_cast<const unsigned char*>(encoded.data()) + 5, PackFile::HASH_SIZE);
+        auto base = resolve(baseHash);
+        cacheBase(baseHash, base);
+        std::string delta = HuffmanCoder::decompress(encoded.substr(DELTA_HEADER_SIZE));
+        return std::make_shared<const std::string>(DeltaCoder::apply(*base, delta));
+    }
+
+    std::string getPackPath() const {
+        return PathUtils::joinPath(objectsPath, "pack");
+    }
+
+    void loadPacks() const {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (packsLoaded) return;
+        packsLoaded = true;
+        for (const auto& entry : PathUtils::listDirectory(getPackPath())) {
+            if (entry.size() <= 4 || entry.substr(entry.size() - 4) != ".idx") continue;
+            auto pack = std::make_unique<PackFile>();
+            if (pack->open(PathUtils::joinPath(getPackPath(), entry))) {
+                packs.push_back(std::move(pack));
+            }
+        }
+    }
+
+    bool hasLooseObject(const std::string& hash) const {
+        return PathUtils::exists(getObjectPath(hash));
+    }
+
+    bool hasPackedObject(const std::string& hash) const {
+        loadPacks();
+        for (const auto& pack : packs) {
+            if (pack->contains(hash)) return true;
+        }
+        return false;
+    }
+
+    static int64_t modifiedTime(const std::string& path) {
+        struct stat buffer;
+        return ::stat(path.c_str(), &buffer) == 0 ? static_cast<int64_t>(buffer.st_mtime) : 0;
+    }
+
+    // Loose objects whose blob belongs in a pack: raw objects can only be
+    // reflinked as files of their own, and packing loads every object whole
+    bool packable(const std::string& hash) const {
+        return !(hasLooseObject(hash) && (PathUtils::getFileSize(getObjectPath(hash)) > getConfig().bigFileThreshold() ||
+                                          isRaw(peekEncoded(hash, 4))));
+    }
+
+    bool writeObject(const std::string& hash, const std::string& encoded) const {
+        PathUtils::createDirectories(objectsPath);
+        // Write to a temporary name first so a partially written blob is never
+        // mistaken for a complete one.
+        std::string tmpPath = PathUtils::joinPath(objectsPath, "tmp_" + HashUtils::generateId());
+        {
+            std::ofstream out(tmpPath, std::ios::binary);
+            if (!out) return false;
+            out << encoded;
+            if (!out) {
+                PathUtils::removeFile(tmpPath);
+                return false;
+            }
+        }
+        if (std::rename(tmpPath.c_str(), getObjectPath(hash).c_str()) != 0) {
+            PathUtils::removeFile(tmpPath);
+            return false;
+        }
+        return true;
+    }
+
+    // Write the contents of a blob to a new file at path
+    bool writeBlobTo(const std::string& hash, const std::string& path, FileCopy::Stats* copyStats) const {
+        std::string header = peekEncoded(hash, 4);
+        if (isRaw(header) && hasLooseObject(hash)) {
+            std::string objectPath = getObjectPath(hash);
+            uint64_t size = PathUtils::getFileSize(objectPath);
+            if (size < RAW_ALIGNMENT) throw std::runtime_error("Truncated object");
+            FileCopy::Stats ignored;
+            return FileCopy::copyRange(objectPath, RAW_ALIGNMENT, size - RAW_ALIGNMENT, path, 0,
+                                       copyStats ? *copyStats : ignored);
+        }
+        bool streamed = isStream(header);
+        std::string content = streamed ? "" : readObject(hash);
+        std::ofstream out(path, std::ios::binary);
+        if (!out) return false;
+        if (streamed) {
+            readStream(*openEncoded(hash), 0, UINT64_MAX, [&](const std::string& chunk) { out << chunk; });
+        } else {
+            out << content;
+        }
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+public:
+    ObjectStore() : objectsPath(PathUtils::joinPath(".vcs", "objects")) {}
+
+    std::string getObjectPath(const std::string& hash) const {
+        return PathUtils::joinPath(objectsPath, hash);
+    }
+
+    bool hasObject(const std::string& hash) const {
+        return !hash.empty() && (hasLooseObject(hash) || hasPackedObject(hash));
+    }
+
+    // Hash a file and store it unless a blob with that hash already exists,
+    // reading the file only once. If baseHash names an earlier version of the
+    // same path, the blob may be stored as a delta against it. Files above the
+    // big-file threshold are streamed instead, or copied raw when they do not
+    // compress; copyStats records how those bytes were copied. Returns the
+    // content hash, or "" if the file could not be read or stored.
+    std::string storeFile(const std::string& filePath, const std::string& baseHash = "",
+                          FileCopy::Stats* copyStats = nullptr) const {
+        FileCopy::Stats ignored;
+        uint64_t size = PathUtils::getFileSize(filePath);
+        if (size > getConfig().bigFileThreshold()) return writeStreamObject(filePath, copyStats ? *copyStats : ignored);
+        // Only files below the threshold are read whole, and no more than the
+        // size just taken: one that has grown since is streamed instead
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file) return "";
+        std::string data(size, '\0');
+        file.read(&data[0], static_cast<std::streamsize>(size));
+        if (file.bad()) return "";
+        data.resize(static_cast<size_t>(file.gcount()));
+        if (file.peek() != std::char_traits<char>::eof()) {
+            return writeStreamObject(filePath, copyStats ? *copyStats : ignored);
+        }
+        std::string hash = HashUtils::computeSHA256(data);
+        if (!hasObject(hash) && !storeData(hash, data, baseHash, filePath)) return "";
+        return hash;
+    }
+
+    // Store contents that are already in memory under a known hash. path only
+    // selects the codec by extension. Returns true if a new blob was written.
+    bool storeData(const std::string& hash, const std::string& data,
+                   const std::string& baseHash = "", const std::string& path = "") const {
+        if (hash.empty() || hasObject(hash)) return false;
+        if (!baseHash.empty() && baseHash != hash) {
+            std::string delta = encodeDelta(data, baseHash);
+            if (!delta.empty()) return writeObject(hash, delta);
+        }
+        return writeObject(hash, encodeFull(data, path));
+    }
+
+    // Return the stored (compressed) bytes of a blob, loose or packed
+    std::string readEncoded(const std::string& hash) const {
+        std::ifstream in(getObjectPath(hash), std::ios::binary);
+        if (in) {
+            return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        }
+        loadPacks();
+        for (const auto& pack : packs) {
+            long pos = pack->find(hash);
+            if (pos >= 0) {
+                auto [data, length] = pack->slice(static_cast<uint32_t>(pos));
+                return std::string(data, length);
+            }
+        }
+        throw std::runtime_error("Missing object: " + hash);
+    }
+
+    // Return at most maxBytes from the start of the stored bytes of a blob
+    std::string peekEncoded(const std::string& hash, size_t maxBytes) const {
+        std::ifstream in(getObjectPath(hash), std::ios::binary);
+        if (in) {
+            std::string header(maxBytes, '\0');
+            in.read(&header[0], maxBytes);
+            header.resize(in.gcount());
+            return header;
+        }
+        loadPacks();
+        for (const auto& pack : packs) {
+            long pos = pack->find(hash);
+            if (pos >= 0) {
+                auto [data, length] = pack->slice(static_cast<uint32_t>(pos));
+                return std::string(data, std::min(length, maxBytes));
+            }
+        }
+        throw std::runtime_error("Missing object: " + hash);
+    }
+
+    // Return the uncompressed contents of a blob
+    std::string readObject(const std::string& hash) const {
+        return *resolve(hash);
+    }
+
+    // True if the blob was stored in chunks because it was above the big-file
+    // threshold, so it should not be read whole
+    bool isChunked(const std::string& hash) const {
+        return isStream(peekEncoded(hash, 4));
+    }
+
+    // Return bytes [offset, offset + length) of a blob. Full blobs stored in
+    // blocks decode only the blocks covering the range.
+    std::string readRange(const std::string& hash, uint64_t offset, uint64_t length) const {
+        if (auto cached = cachedBase(hash)) {
+            return offset < cached->size() ? cached->substr(offset, length) : "";
+        }
+        if (isStream(peekEncoded(hash, 4))) {
+            std::string range;
+            readStream(*openEncoded(hash), offset, length, [&](const std::string& chunk) { range += chunk; });
+            return range;
+        }
+        if (isRaw(peekEncoded(hash, 4))) {
+            auto reader = openEncoded(hash);
+            uint64_t size = reader->size() >= RAW_ALIGNMENT ? reader->size() - RAW_ALIGNMENT : 0;
+            if (offset >= size) return "";
+            std::string range(std::min<uint64_t>(length, size - offset), '\0');
+            reader->skip(RAW_ALIGNMENT + offset);
+            reader->read(&range[0], range.size());
+            return range;
+        }
+        std::string encoded = readEncoded(hash);
+        if (hasCodecHeader(encoded)) {
+            return Codecs::get(static_cast<uint8_t>(encoded[4]))
+                .decodeRange(encoded.substr(FULL_HEADER_SIZE), offset, length);
+        }
+        if (!isDelta(encoded)) return HuffmanCoder::decompressRange(encoded, offset, length);
+        std::string content = *resolve(hash);
+        return offset < content.size() ? content.substr(offset, length) : "";
+    }
+
+    // Write the contents of a blob to destFile, creating parent directories.
+    // Streamed blobs are decoded one chunk at a time, and loose raw blobs are
+    // copied (or reflinked) straight from the store; copyStats records how.
+    // The blob is written to destFile.tmp and renamed over destFile, so a
+    // failed restore leaves the old file in place.
+    bool restoreFile(const std::string& hash, const std::string& destFile,
+                     FileCopy::Stats* copyStats = nullptr) const {
+        std::string dir = PathUtils::getDirectory(destFile);
+        if (!dir.empty()) PathUtils::createDirectories(dir);
+        std::string tmpPath = destFile + ".tmp";
+        PathUtils::removeFile(tmpPath);
+        bool written = false;
+        try {
+            written = writeBlobTo(hash, tmpPath, copyStats);
+        } catch (...) {
+            PathUtils::removeFile(tmpPath);
+            throw;
+        }
+        if (!written || std::rename(tmpPath.c_str(), destFile.c_str()) != 0) {
+            PathUtils::removeFile(tmpPath);
+            return false;
+        }
+        return true;
+    }
+
+    // Hashes of all blobs currently stored as individual files
+    std::vector<std::string> listLooseObjects() const {
+        std::vector<std::string> hashes;
+        for (const auto& entry : PathUtils::listDirectory(objectsPath)) {
+            if (HashUtils::isHexDigest(entry)) hashes.push_back(entry);
+        }
+        return hashes;
+    }
+
+    // Hash of the object a stored object is a delta against, or "" if it is
+    // stored whole
+    std::string deltaBase(const std::string& hash) const {
+        std::string header = peekEncoded(hash, DELTA_HEADER_SIZE);
+        if (!isDelta(header)) return "";
+        return HashUtils::binaryToHex(reinterpret_cast<const unsigned char*>(header.data()) + 5, PackFile::HASH_SIZE);
+    }
+
+    // Disk space taken by loose objects and packs, counting whole blocks,
+    // since that is what many small loose files cost
+    uint64_t diskUsage() const {
+        auto usage = [](const std::string& path) {
+            struct stat buffer;
+            return ::stat(path.c_str(), &buffer) == 0 ? static_cast<uint64_t>(buffer.st_blocks) * 512 : 0;
+        };
+        uint64_t total = 0;
+        for (const auto& hash : listLooseObjects()) total += usage(getObjectPath(hash));
+        for (const auto& entry : PathUtils::listDirectory(getPackPath())) {
+            total += usage(PathUtils::joinPath(getPackPath(), entry));
+        }
+        return total;
+    }
+
+    // Rewrite the store around the reachable objects, given in the order they
+    // should be laid out. They go into one new pack that replaces all others,
+    // except the ones that stay loose anyway. Unreachable objects written at
+    // or after keepSince (seconds since the epoch) are kept as loose files
+    // with their original times, so their grace period is not restarted, and
+    // so are their delta bases; older ones are deleted, along with temporary
+    // files that old.
+    GcStats collectGarbage(const std::vector<std::string>& reachable, int64_t keepSince) {
+        GcStats stats;
+        stats.bytesBefore = diskUsage();
+        std::unordered_map<std::string, int64_t> stored;  // every object -> when it was written
+        for (const auto& hash : listLooseObjects()) stored[hash] = modifiedTime(getObjectPath(hash));
+        loadPacks();
+        for (const auto& pack : packs) {
+            int64_t time = modifiedTime(PathUtils::joinPath(getPackPath(), pack->getName() + ".pack"));
+            for (uint32_t i = 0; i < pack->size(); ++i) {
+                auto [it, added] = stored.emplace(pack->hashAt(i), time);
+                if (!added) it->second = std::max(it->second, time);
+            }
+        }
+
+        std::vector<std::string> packed;
+        std::unordered_set<std::string> keep;
+        for (const auto& hash : reachable) {
+            if (!stored.count(hash) || !keep.insert(hash).second) continue;
+            if (!packable(hash)) {
+                ++stats.loose;
+                continue;
+            }
+            packed.push_back(hash);
+        }
+        stats.packed = packed.size();
+
+        // Unreachable objects: keep the recent ones along with every object
+        // they are a delta against, however old, and move those still in
+        // packs out to loose files. Delete the rest.
+        std::vector<std::string> recent;
+        for (const auto& [hash, time] : stored) {
+            if (!keep.count(hash) && time >= keepSince) recent.push_back(hash);
+        }
+        keep.insert(recent.begin(), recent.end());
+        for (size_t i = 0; i < recent.size(); ++i) {
+            std::string base = deltaBase(recent[i]);
+            if (!base.empty() && stored.count(base) && keep.insert(base).second) recent.push_back(base);
+        }
+        std::vector<std::string> expired;
+        for (const auto& [hash, time] : stored) {
+            if (!keep.count(hash)) expired.push_back(hash);
+        }
+        for (const auto& hash : recent) {
+            ++stats.recent;
+            if (hasLooseObject(hash)) continue;
+            int64_t time = stored[hash];
+            if (!writeObject(hash, readEncoded(hash))) throw std::runtime_error("Could not write object " + hash);
+            struct timespec times[2] = {{time, 0}, {time, 0}};
+            ::utimensat(AT_FDCWD, getObjectPath(hash).c_str(), times, 0);
+        }
+        stats.removed = expired.size();
+
+        std::string newPack;
+        if (!packed.empty()) {
+            std::string idxPath = PackFile::write(getPackPath(), packed,
+                                                  [this](const std::string& hash) { return readEncoded(hash); });
+            if (idxPath.empty()) throw std::runtime_error("Could not write pack file");
+            std::string base = idxPath.substr(0, idxPath.size() - 4);
+            newPack = base.substr(base.find_last_of('/') + 1);
+        }
+        // Everything needed is now in the new pack or loose; drop the rest
+        std::vector<std::string> oldPacks;
+        for (const auto& pack : packs) {
+            if (pack->getName() != newPack) oldPacks.push_back(pack->getName());
+        }
+        packs.clear();
+        packsLoaded = false;
+        for (const auto& name : oldPacks) {
+            PathUtils::removeFile(PathUtils::joinPath(getPackPath(), name + ".idx"));
+            PathUtils::removeFile(PathUtils::joinPath(getPackPath(), name + ".pack"));
+        }
+        for (const auto& hash : packed) PathUtils::removeFile(getObjectPath(hash));
+        for (const auto& hash : expired) PathUtils::removeFile(getObjectPath(hash));
+        for (const auto& dir : {objectsPath, getPackPath()}) {
+            for (const auto& name : PathUtils::listDirectory(dir)) {
+                bool temporary = name.compare(0, 4, "tmp_") == 0 ||
+                                 (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0);
+                std::string path = PathUtils::joinPath(dir, name);
+                if (temporary && modifiedTime(path) < keepSince) PathUtils::removeFile(path);
+            }
+        }
+        stats.bytesAfter = diskUsage();
+        return stats;
+    }
+
+    // Fold all loose objects into a single new pack, then delete them.
+    // Objects above the big-file threshold stay loose, since packing reads
+    // each object whole, and so do raw objects, which can only be reflinked
+    // while they are files of their own.
+    RepackStats repack() {
+        RepackStats stats;
+        std::vector<std::string> packed;
+        for (const auto& hash : listLooseObjects()) {
+            if (!packable(hash)) continue;
+            stats.looseBytes += PathUtils::getFileSize(getObjectPath(hash));
+            packed.push_back(hash);
+        }
+        if (packed.empty()) return stats;
+        std::string idxPath = PackFile::write(getPackPath(), packed,
+                                              [this](const std::string& hash) { return readEncoded(hash); });
+        if (idxPath.empty()) throw std::runtime_error("Could not write pack file");
+        stats.objects = packed.size();
+        stats.packBytes = PathUtils::getFileSize(idxPath) +
+            PathUtils::getFileSize(idxPath.substr(0, idxPath.size() - 4) + ".pack");
+        for (const auto& hash : packed) PathUtils::removeFile(getObjectPath(hash));
+        packs.clear();
+        packsLoaded = false;
+        return stats;
+    }
+};
@@ -0,0 +1,190 @@
+#pragma once
+#include "../utils/pathUtils.hpp"
+#include "../utils/hashUtils.hpp"
+#include "../utils/binaryIO.hpp"
+#include "../utils/mappedFile.hpp"
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+
+// A pack is one append-only data file holding many encoded objects back to
+// back, plus a sorted index mapping each object hash to its byte range.
+//
+// pack-<name>.pack: "VPCK" | version u32 | count u32 | object bytes...
+// pack-<name>.idx:  "VIDX" | version u32 | count u32 | fanout u32[256] |
+//                   count x (hash[32] | offset u64 | length u64)
+//
+// fanout[b] is the number of entries whose first hash byte is <= b, which
+// narrows the binary search to the entries sharing the first byte.
+class PackFile {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HASH_SIZE = 32;
+    static constexpr size_t PACK_HEADER_SIZE = 12;
+    static constexpr size_t IDX_HEADER_SIZE = 12 + 256 * 4;
+    static constexpr size_t IDX_ENTRY_SIZE = HASH_SIZE + 16;
+
+private:
+    std::string name;
+    MappedFile index;
+    MappedFile pack;
+    uint32_t count = 0;
+
+    const unsigned char* entryAt(uint32_t i) const {
+        return index.data() + IDX_HEADER_SIZE + static_cast<size_t>(i) * IDX_ENTRY_SIZE;
+    }
+
+    static bool writeFile(const std::string& path, const std::string& content) {
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(content.data(), 1, content.size(), f) == content.size();
+        ok = std::fflush(f) == 0 && ok;
+        ok = fsync(fileno(f)) == 0 && ok;
+        return std::fclose(f) == 0 && ok;
+    }
+
+public:
+    // Map a pack given the path of its .idx file
+    bool open(const std::string& idxPath) {
+        std::string base = idxPath.substr(0, idxPath.size() - 4);
+        if (!index.open(idxPath) || !pack.open(base + ".pack")) return false;
+        if (index.size() < IDX_HEADER_SIZE || std::memcmp(index.data(), "VIDX", 4) != 0 ||
+            BinaryIO::getU32(index.data() + 4) != VERSION) {
+            return false;
+        }
+        if (pack.size() < PACK_HEADER_SIZE || std::memcmp(pack.data(), "VPCK", 4) != 0) {
+            return false;
+        }
+        count = BinaryIO::getU32(index.data() + 8);
+        if (index.size() < IDX_HEADER_SIZE + static_cast<size_t>(count) * IDX_ENTRY_SIZE) return false;
+        name = base.substr(base.find_last_of('/') + 1);
+        return true;
+    }
+
+    const std::string& getName() const { return name; }
+    uint32_t size() const { return count; }
+
+    // Binary search for a hex hash; returns the entry position or -1
+    long find(const std::string& hash) const {
+        if (count == 0 || hash.size() != HASH_SIZE * 2) return -1;
+        std::string key = HashUtils::hexToBinary(hash);
+        unsigned char first = static_cast<unsigned char>(key[0]);
+        const unsigned char* fanout = index.data() + 12;
+        uint32_t lo = first == 0 ? 0 : BinaryIO::getU32(fanout + (first - 1) * 4);
+        uint32_t hi = BinaryIO::getU32(fanout + first * 4);
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            int cmp = std::memcmp(entryAt(mid), key.data(), HASH_SIZE);
+            if (cmp == 0) return mid;
+            if (cmp < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        return -1;
+    }
+
+    bool contains(const std::string& hash) const {
+        return find(hash) >= 0;
+    }
+
+    // Encoded bytes of the object at position i, as a view into the mapping
+    std::pair<const char*, size_t> slice(uint32_t i) const {
+        const unsigned char* entry = entryAt(i);
+        uint64_t offset = BinaryIO::getU64(entry + HASH_SIZE);
+        uint64_t length = BinaryIO::getU64(entry + HASH_SIZE + 8);
+        if (offset + length > pack.size()) throw std::runtime_error("Corrupt pack: " + name);
+        return {reinterpret_cast<const char*>(pack.data() + offset), length};
+    }
+
+    std::string hashAt(uint32_t i) const {
+        return HashUtils::binaryToHex(entryAt(i), HASH_SIZE);
+    }
+
+    // Write a new pack and index into packDir from the objects named by
+    // hashes, fetching each one's encoded bytes with read just before it is
+    // appended, so only the index is held in memory. Object bytes are laid
+    // out in the order given, so objects read together can be kept together;
+    // only the index is sorted by hash. A repeated hash keeps its first
+    // entry. The index is renamed into place last, so readers never see an
+    // index without its data file. Returns the path of the new .idx file, or
+    // "" on failure.
+    static std::string write(const std::string& packDir, const std::vector<std::string>& hashes,
+                             const std::function<std::string(const std::string& hash)>& read) {
+        if (hashes.empty()) return "";
+        std::vector<size_t> order(hashes.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+                         [&](size_t a, size_t b) { return hashes[a] < hashes[b]; });
+        order.erase(std::unique(order.begin(), order.end(),
+                    [&](size_t a, size_t b) { return hashes[a] == hashes[b]; }), order.end());
+        std::vector<bool> included(hashes.size());
+        std::string hashList;
+        for (size_t i : order) {
+            included[i] = true;
+            hashList += HashUtils::hexToBinary(hashes[i]);
+        }
+
+        PathUtils::createDirectories(packDir);
+        std::string base = PathUtils::joinPath(packDir, "pack-" + HashUtils::computeSHA256(hashList));
+        std::string tmpPack = base + ".pack.tmp";
+        std::string tmpIdx = base + ".idx.tmp";
+        auto fail = [&]() {
+            PathUtils::removeFile(tmpPack);
+            PathUtils::removeFile(tmpIdx);
+            return std::string();
+        };
+
+        std::vector<uint64_t> offsets(hashes.size());
+        std::vector<uint64_t> lengths(hashes.size());
+        FILE* f = std::fopen(tmpPack.c_str(), "wb");
+        if (!f) return fail();
+        std::string header = "VPCK";
+        BinaryIO::putU32(header, VERSION);
+        BinaryIO::putU32(header, static_cast<uint32_t>(order.size()));
+        bool ok = std::fwrite(header.data(), 1, header.size(), f) == header.size();
+        uint64_t position = header.size();
+        try {
+            for (size_t i = 0; ok && i < hashes.size(); ++i) {
+                if (!included[i]) continue;
+                std::string encoded = read(hashes[i]);
+                offsets[i] = position;
+                lengths[i] = encoded.size();
+                ok = std::fwrite(encoded.data(), 1, encoded.size(), f) == encoded.size();
+                position += encoded.size();
+            }
+        } catch (...) {
+            std::fclose(f);
+            fail();
+            throw;
+        }
+        ok = ok && std::fflush(f) == 0;
+        ok = ok && fsync(fileno(f)) == 0;
+        if (std::fclose(f) != 0 || !ok) return fail();
+
+        std::string idxData = "VIDX";
+        BinaryIO::putU32(idxData, VERSION);
+        BinaryIO::putU32(idxData, static_cast<uint32_t>(order.size()));
+        uint32_t fanout[256] = {0};
+        for (size_t i = 0; i < hashList.size(); i += HASH_SIZE) {
+            fanout[static_cast<unsigned char>(hashList[i])]++;
+        }
+        uint32_t running = 0;
+        for (uint32_t b = 0; b < 256; ++b) {
+            running += fanout[b];
+            BinaryIO::putU32(idxData, running);
+        }
+        for (size_t n = 0; n < order.size(); ++n) {
+            idxData.append(hashList, n * HASH_SIZE, HASH_SIZE);
+            BinaryIO::putU64(idxData, offsets[order[n]]);
+            BinaryIO::putU64(idxData, lengths[order[n]]);
+        }
+        if (!writeFile(tmpIdx, idxData) ||
+            std::rename(tmpPack.c_str(), (base + ".pack").c_str()) != 0 ||
+            std::rename(tmpIdx.c_str(), (base + ".idx").c_str()) != 0) {
+            return fail();
+        }
+        return base + ".idx";
+    }
+};
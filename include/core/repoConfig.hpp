@@ -0,0 +1,112 @@
+#pragma once
+#include "../utils/pathUtils.hpp"
+#include "../utils/codec.hpp"
+#include "../common.hpp"
+#include <cctype>
+
+// Per-repository settings from .vcs/config (JSON). The file is optional and
+// every key has a default:
+//
+//   {
+//     "core": {
+//       "bigFileThreshold": 67108864,
+//       "workers": 0,
+//       "gcGraceSeconds": 1209600
+//     },
+//     "compression": {
+//       "codec": "auto",
+//       "extensions": { ".png": "stored", ".txt": "lz" }
+//     }
+//   }
+//
+// Codec names are "auto", "stored", "huffman" and "lz". "auto" stores data
+// raw when a sample looks incompressible and uses "lz" otherwise.
+//
+// Files larger than bigFileThreshold bytes are hashed, compressed and
+// restored in fixed-size chunks instead of being loaded into memory.
+// workers is the number of threads that hash and compress files during
+// `vcs add`; 0 means one per hardware thread. `vcs gc` only deletes
+// unreachable objects written more than gcGraceSeconds ago (two weeks), so
+// a command storing objects at the same time does not lose them.
+class RepoConfig {
+public:
+    static constexpr uint64_t DEFAULT_BIG_FILE_THRESHOLD = 64 * 1024 * 1024;
+    static constexpr uint64_t DEFAULT_GC_GRACE_SECONDS = 14 * 24 * 60 * 60;
+
+private:
+    json settings = json::object();
+
+    static std::string lowercase(std::string text) {
+        for (auto& c : text) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return text;
+    }
+
+    static std::string checkCodec(const json& value) {
+        if (!value.is_string() || !Codecs::isValidName(value.get<std::string>())) {
+            throw std::runtime_error("Invalid codec in .vcs/config: " + value.dump());
+        }
+        return value.get<std::string>();
+    }
+
+    uint64_t coreNumber(const std::string& key, uint64_t fallback) const {
+        auto core = settings.find("core");
+        if (core == settings.end() || !core->is_object()) return fallback;
+        auto value = core->find(key);
+        if (value == core->end()) return fallback;
+        if (!value->is_number_unsigned()) {
+            throw std::runtime_error("Invalid " + key + " in .vcs/config: " + value->dump());
+        }
+        return value->get<uint64_t>();
+    }
+
+public:
+    static std::string getConfigPath() {
+        return PathUtils::joinPath(".vcs", "config");
+    }
+
+    static RepoConfig load() {
+        RepoConfig config;
+        std::ifstream in(getConfigPath());
+        if (!in) return config;
+        try {
+            in >> config.settings;
+        } catch (const json::exception& e) {
+            throw std::runtime_error("Could not parse .vcs/config: " + std::string(e.what()));
+        }
+        if (!config.settings.is_object()) throw std::runtime_error("Could not parse .vcs/config");
+        return config;
+    }
+
+    uint64_t bigFileThreshold() const {
+        return coreNumber("bigFileThreshold", DEFAULT_BIG_FILE_THRESHOLD);
+    }
+
+    size_t workers() const {
+        return static_cast<size_t>(coreNumber("workers", 0));
+    }
+
+    uint64_t gcGraceSeconds() const {
+        return coreNumber("gcGraceSeconds", DEFAULT_GC_GRACE_SECONDS);
+    }
+
+    // Codec name for a file, from its extension if configured, else the
+    // repository default
+    std::string codecFor(const std::string& path) const {
+        auto compression = settings.find("compression");
+        if (compression == settings.end() || !compression->is_object()) return "auto";
+        auto extensions = compression->find("extensions");
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("/\\");
+        if (extensions != compression->end() && extensions->is_object() && dot != std::string::npos &&
+            (slash == std::string::npos || dot > slash)) {
+            std::string extension = lowercase(path.substr(dot));
+            for (auto it = extensions->begin(); it != extensions->end(); ++it) {
+                std::string key = lowercase(it.key());
+                if (key.empty() || key[0] != '.') key = "." + key;
+                if (key == extension) return checkCodec(it.value());
+            }
+        }
+        auto codec = compression->find("codec");
+        return codec == compression->end() ? "auto" : checkCodec(*codec);
+    }
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include "../utils/pathUtils.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Metadata changes made by one command, queued by the stores when they are
+// flushed and written together by commit():
+//
+//   1. every target file is locked by creating <path>.lock exclusively and
+//      checked against what this process read: a replaced file against its
+//      old contents when those are given, an extended file against its size;
+//   2. replacement contents are written to the lock files, and extensions
+//      in place after cutting off anything past the offset they start at;
+//   3. one syncfs() makes all of it durable, along with the objects the
+//      command stored;
+//   4. the lock files are renamed over their targets in the order they were
+//      queued, then queued removals run.
+//
+// Nothing is visible until step 4, except records added at the end of the
+// commit log and graph, which readers tolerate as unreferenced. A command
+// that changes nothing queues nothing and writes nothing.
+class RepoTransaction {
+private:
+    struct Replacement {
+        std::string path;
+        std::string contents;
+        std::optional<std::string> expected;
+    };
+    struct Extension {
+        std::string path;
+        uint64_t expectedSize;
+        uint64_t offset;
+        std::string data;
+    };
+
+    // Exclusive lock on one file, released (and its lock file removed)
+    // unless the lock file was renamed over the target
+    class Lock {
+    private:
+        std::string lockPath;
+        int fd = -1;
+
+    public:
+        explicit Lock(const std::string& path) : lockPath(path + ".lock") {
+            PathUtils::createDirectories(PathUtils::getDirectory(path));
+            fd = ::open(lockPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+            if (fd < 0) {
+                throw std::runtime_error("Could not lock " + lockPath +
+                    (errno == EEXIST ? " (is another vcs process running? If not, remove the file)" : ""));
+            }
+        }
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+        ~Lock() {
+            if (fd >= 0) ::close(fd);
+            if (!lockPath.empty()) PathUtils::removeFile(lockPath);
+        }
+
+        bool write(const std::string& data) {
+            for (size_t written = 0; written < data.size();) {
+                ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                written += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        bool renameTo(const std::string& path) {
+            bool ok = ::close(fd) == 0;
+            fd = -1;
+            if (!ok || std::rename(lockPath.c_str(), path.c_str()) != 0) return false;
+            lockPath.clear();
+            return true;
+        }
+    };
+
+    std::vector<Replacement> replacements;
+    std::vector<Extension> extensions;
+    std::vector<std::string> removals;
+
+    static std::string readAll(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    static bool writeAt(const Extension& extension) {
+        int fd = ::open(extension.path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd < 0) return false;
+        bool ok = ftruncate(fd, static_cast<off_t>(extension.offset)) == 0;
+        for (size_t written = 0; ok && written < extension.data.size();) {
+            ssize_t n = pwrite(fd, extension.data.data() + written, extension.data.size() - written,
+                               static_cast<off_t>(extension.offset + written));
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0;
+            if (ok) written += static_cast<size_t>(n);
+        }
+        return ::close(fd) == 0 && ok;
+    }
+
+    static uint64_t fileSize(const std::string& path) {
+        struct stat st;
+        return ::stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    }
+
+public:
+    // Replace a file atomically. If expected is set, the file must still
+    // hold exactly that ("" if it did not exist).
+    void replace(const std::string& path, std::string contents, std::optional<std::string> expected = std::nullopt) {
+        for (auto& replacement : replacements) {
+            if (replacement.path == path) {
+                replacement.contents = std::move(contents);
+                return;
+            }
+        }
+        replacements.push_back({path, std::move(contents), std::move(expected)});
+    }
+
+    // Write data at offset into a file that was expectedSize bytes long when
+    // read, dropping whatever followed offset
+    void extend(const std::string& path, uint64_t expectedSize, uint64_t offset, std::string data) {
+        extensions.push_back({path, expectedSize, offset, std::move(data)});
+    }
+
+    // Delete a file or directory once everything else is in place
+    void remove(const std::string& path) { removals.push_back(path); }
+
+    bool empty() const { return replacements.empty() && extensions.empty() && removals.empty(); }
+
+    void commit() {
+        if (empty()) return;
+        std::vector<std::unique_ptr<Lock>> extensionLocks;
+        for (const auto& extension : extensions) {
+            extensionLocks.push_back(std::make_unique<Lock>(extension.path));
+            if (fileSize(extension.path) != extension.expectedSize) {
+                throw std::runtime_error(extension.path + " was changed by another process");
+            }
+        }
+        std::vector<std::unique_ptr<Lock>> replacementLocks;
+        for (const auto& replacement : replacements) {
+            replacementLocks.push_back(std::make_unique<Lock>(replacement.path));
+            if (replacement.expected && readAll(replacement.path) != *replacement.expected) {
+                throw std::runtime_error(replacement.path + " was changed by another process");
+            }
+            if (!replacementLocks.back()->write(replacement.contents)) {
+                throw std::runtime_error("Could not write " + replacement.path);
+            }
+        }
+        for (const auto& extension : extensions) {
+            if (!writeAt(extension)) throw std::runtime_error("Could not write " + extension.path);
+        }
+        int dirFd = ::open(".vcs", O_RDONLY | O_DIRECTORY);
+        bool synced = dirFd >= 0 && syncfs(dirFd) == 0;
+        if (dirFd >= 0) ::close(dirFd);
+        if (!synced) throw std::runtime_error("Could not sync repository data to disk");
+        for (size_t i = 0; i < replacements.size(); ++i) {
+            if (!replacementLocks[i]->renameTo(replacements[i].path)) {
+                throw std::runtime_error("Could not write " + replacements[i].path);
+            }
+        }
+        for (const auto& path : removals) {
+            if (PathUtils::isDirectory(path)) PathUtils::removeDirectory(path);
+            else PathUtils::removeFile(path);
+        }
+        replacements.clear();
+        extensions.clear();
+        removals.clear();
+    }
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include "../models/tree.hpp"
+#include "../utils/lruCache.hpp"
+#include "objectStore.hpp"
+#include <functional>
+#include <map>
+#include <memory>
+
+// Directory trees kept in the object store. A tree names each child by hash,
+// so two snapshots share every directory that did not change, and comparing
+// them only opens directories whose hashes differ.
+//
+// Commits made before trees existed list their files flat; their trees are
+// built in memory on demand ("virtual" trees) and only stored once a new tree
+// refers to them.
+class TreeStore {
+private:
+    static constexpr size_t CACHE_ENTRIES = 1 << 18;
+    const ObjectStore& objectStore;
+    mutable LruCache<std::string, std::shared_ptr<const Tree>> cache{CACHE_ENTRIES};
+    mutable std::unordered_map<std::string, std::shared_ptr<const Tree>> virtualTrees;
+
+    struct Node {
+        std::map<std::string, Node> dirs;
+        std::vector<TreeEntry> files;
+    };
+
+    std::string writeNode(Node& node, const std::string& baseHash, bool persist) const {
+        auto base = persist && !baseHash.empty() ? read(baseHash) : nullptr;
+        auto tree = std::make_shared<Tree>();
+        tree->entries = std::move(node.files);
+        for (auto& [name, child] : node.dirs) {
+            const TreeEntry* baseEntry = base ? base->find(name) : nullptr;
+            std::string childBase = baseEntry && baseEntry->isTree() ? baseEntry->hash.hex() : "";
+            tree->entries.push_back({name, Tree::TREE_MODE, Digest::fromHex(writeNode(child, childBase, persist))});
+        }
+        tree->sort();
+        if (persist) return store(*tree, baseHash);
+        std::string hash = HashUtils::computeSHA256(tree->encode());
+        virtualTrees.emplace(hash, std::move(tree));
+        return hash;
+    }
+
+public:
+    explicit TreeStore(const ObjectStore& objectStore) : objectStore(objectStore) {}
+
+    // The tree stored under hash; "" is the empty tree
+    std::shared_ptr<const Tree> read(const std::string& hash) const {
+        static const auto emptyTree = std::make_shared<const Tree>();
+        if (hash.empty()) return emptyTree;
+        if (auto* cached = cache.get(hash)) return *cached;
+        auto it = virtualTrees.find(hash);
+        if (it != virtualTrees.end()) return it->second;
+        auto tree = std::make_shared<const Tree>(Tree::decode(objectStore.readObject(hash)));
+        cache.put(hash, tree, tree->entries.size() + 1);
+        return tree;
+    }
+
+    // Store a tree (entries sorted), as a delta against baseHash when that
+    // is smaller, and return its hash
+    std::string store(const Tree& tree, const std::string& baseHash = "") const {
+        for (const auto& entry : tree.entries) {
+            if (entry.isTree() && !virtualTrees.empty()) persist(entry.hash.hex());
+        }
+        std::string data = tree.encode();
+        std::string hash = HashUtils::computeSHA256(data);
+        objectStore.storeData(hash, data, baseHash);
+        return hash;
+    }
+
+    // Store a virtual tree and the virtual trees below it; stored trees are
+    // left alone
+    void persist(const std::string& hash) const {
+        auto it = virtualTrees.find(hash);
+        if (it == virtualTrees.end()) return;
+        auto tree = it->second;
+        virtualTrees.erase(it);
+        store(*tree);
+    }
+
+    // Build the trees of a flat file list bottom-up and return the root hash.
+    // Stored directories are offered their version under baseRoot as a delta
+    // base; with persist unset they are kept in memory only.
+    std::string write(const FileMap& files, const std::string& baseRoot = "", bool persist = true) const {
+        Node root;
+        for (const auto& [path, entry] : files) {
+            Node* node = &root;
+            size_t start = 0;
+            for (size_t slash; (slash = path.find('/', start)) != std::string::npos; start = slash + 1) {
+                node = &node->dirs[path.substr(start, slash - start)];
+            }
+            node->files.push_back({path.substr(start), entry.mode, entry.hash});
+        }
+        return writeNode(root, baseRoot, persist);
+    }
+
+    // Every file under a tree by path
+    void flatten(const std::string& root, FileMap& files, const std::string& prefix = "") const {
+        for (const auto& entry : read(root)->entries) {
+            if (entry.isTree()) flatten(entry.hash.hex(), files, prefix + entry.name + "/");
+            else files[prefix + entry.name] = {entry.hash, entry.mode};
+        }
+    }
+
+    FileMap flatten(const std::string& root) const {
+        FileMap files;
+        flatten(root, files);
+        return files;
+    }
+
+    // Report each file whose contents or mode differ between two trees, with
+    // its entry on either side (nullptr where it does not exist). Subtrees
+    // with equal hashes are skipped without being read.
+    using DiffCallback = std::function<void(const std::string& path, const TreeEntry* from, const TreeEntry* to)>;
+
+    void diff(const std::string& fromHash, const std::string& toHash, const DiffCallback& emit,
+              const std::string& prefix = "") const {
+        if (fromHash == toHash) return;
+        auto from = read(fromHash);
+        auto to = read(toHash);
+        auto a = from->entries.begin();
+        auto b = to->entries.begin();
+        while (a != from->entries.end() || b != to->entries.end()) {
+            int order = a == from->entries.end() ? 1 : b == to->entries.end() ? -1 : a->name.compare(b->name);
+            const TreeEntry* left = order <= 0 ? &*a++ : nullptr;
+            const TreeEntry* right = order >= 0 ? &*b++ : nullptr;
+            if (left && right && left->hash == right->hash && left->mode == right->mode) continue;
+            std::string path = prefix + (left ? left : right)->name;
+            bool leftTree = left && left->isTree();
+            bool rightTree = right && right->isTree();
+            diff(leftTree ? left->hash.hex() : "", rightTree ? right->hash.hex() : "", emit, path + "/");
+            if ((left && !leftTree) || (right && !rightTree)) {
+                emit(path, leftTree ? nullptr : left, rightTree ? nullptr : right);
+            }
+        }
+    }
+};
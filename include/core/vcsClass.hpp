@@ -4,17 +4,29 @@
 #include "../utils/hashUtils.hpp"
 #include "commitManager.hpp"
 #include "branchManager.hpp"
+#include "index.hpp"
+#include "repoTransaction.hpp"
+#include "../utils/dirWalker.hpp"
+#include "../utils/unifiedDiff.hpp"
+#include <optional>
+#include <set>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <unistd.h>
+#include <sys/stat.h>
 
 class VCS {
 private:
     CommitManager commitManager;
     BranchManager branchManager;
+    RepoTransaction transaction;
 
     struct FileStatus {
         bool isStaged;
         bool isModified;
         bool isUntracked;
-        std::string hash;
+        std::optional<Digest> hash;  // unset if the file could not be read
     };
     std::unordered_map<std::string, FileStatus> fileStatuses;
 
@@ -28,76 +40,321 @@ private:
         }
     }
 
-    void calculateFileStatus(const std::string& filePath, FileStatus& status) {
-        std::string relativePath = PathUtils::getRelativePath(filePath, PathUtils::getCurrentPath());
-        if (relativePath.find(".vcs") == 0) return;
-        bool existsInWorkDir = PathUtils::exists(filePath);
-        bool existsInStaging = PathUtils::exists(PathUtils::joinPath(".vcs", "staging_area", relativePath));
-        std::string currentCommitId = branchManager.getCurrentCommitId();
-        bool existsInCommit = false;
-        if (!currentCommitId.empty()) {
-            existsInCommit = PathUtils::exists(PathUtils::joinPath(".vcs", "commits", currentCommitId, "data", relativePath));
-        }
-        status.isUntracked = existsInWorkDir && !existsInStaging && !existsInCommit;
-        status.isStaged = existsInStaging;
-        if (existsInWorkDir) {
-            std::string currentHash = HashUtils::computeSHA256(filePath);
-            std::string previousHash;
-            if (existsInStaging) {
-                previousHash = HashUtils::computeSHA256(PathUtils::joinPath(".vcs", "staging_area", relativePath));
-                status.isModified = currentHash != previousHash;
-            } else if (existsInCommit) {
-                previousHash = HashUtils::computeSHA256(PathUtils::joinPath(".vcs", "commits", currentCommitId, "data", relativePath));
-                status.isModified = currentHash != previousHash;
+    // Store working-tree files in the object store and record them in the
+    // staging manifest. Files whose stat data matches the index and whose
+    // blob exists are not read again.
+    void stageFiles(const std::vector<std::string>& files, Index& index, size_t jobs) {
+        FileMap headFiles = commitManager.getCommitFiles(branchManager.getCurrentCommitId());
+        std::vector<PathUtils::FileStat> stats(files.size());
+        std::vector<Digest> hashes(files.size());
+        std::vector<std::string> toStore;
+        std::vector<size_t> storeSlots;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (DirWalker::isMetadataPath(files[i])) {
+                throw std::runtime_error("Cannot stage repository metadata: " + files[i]);
+            }
+            if (!PathUtils::statFile(files[i], stats[i])) {
+                throw std::runtime_error("Could not stage file: " + files[i]);
             }
-            status.hash = currentHash;
+            auto cached = index.cachedHash(files[i], stats[i]);
+            if (cached) hashes[i] = *cached;
+            if (!cached || !commitManager.hasObject(*cached)) {
+                toStore.push_back(files[i]);
+                storeSlots.push_back(i);
+            }
+        }
+        auto stored = commitManager.storeFiles(".", toStore, &headFiles, jobs);
+        for (size_t k = 0; k < stored.size(); ++k) {
+            size_t i = storeSlots[k];
+            hashes[i] = stored[k];
+            index.record(files[i], stats[i], hashes[i]);
+        }
+        for (size_t i = 0; i < files.size(); ++i) index.stage(files[i], hashes[i], stats[i].mode);
+    }
+
+    // Earlier versions staged files by copying them into .vcs/staging_area.
+    // Store and stage any such copies once; the directory is removed when
+    // the command persists the index.
+    void migrateStagingArea(Index& index) {
+        std::string stagingPath = PathUtils::joinPath(".vcs", "staging_area");
+        if (!PathUtils::isDirectory(stagingPath)) return;
+        auto files = DirWalker::listFiles(stagingPath);
+        auto hashes = commitManager.storeFiles(stagingPath, files, nullptr, 0);
+        for (size_t i = 0; i < files.size(); ++i) {
+            PathUtils::FileStat stat;
+            PathUtils::statFile(PathUtils::joinPath(stagingPath, files[i]), stat);
+            index.stage(files[i], hashes[i], stat.mode);
+        }
+        transaction.remove(stagingPath);
+    }
+
+    // The index for a command that writes. Such commands also move what
+    // earlier versions kept under .vcs into the current formats; read-only
+    // commands leave it alone.
+    Index openIndex() {
+        Index index;
+        migrateStagingArea(index);
+        commitManager.migrateLegacyData();
+        return index;
+    }
+
+    // Write what this command changed, in one transaction. Commands that
+    // change nothing never get here and write nothing.
+    void persist(Index* index = nullptr) {
+        commitManager.flush(transaction);
+        if (index) index->flush(transaction);
+        branchManager.flush(transaction);
+        transaction.commit();
+    }
+
+    // Save the stat data a read-only command refreshed. Skipped if another
+    // process holds the index or has changed it since it was loaded: the
+    // cache is only an optimization.
+    static void saveStatCache(Index& index) {
+        RepoTransaction tx;
+        index.flush(tx, true);
+        try {
+            tx.commit();
+        } catch (const std::runtime_error&) {
+        }
+    }
+
+    // Say how file data was moved, if any was copied rather than encoded
+    static void reportCopyStats(const FileCopy::Stats& stats) {
+        if (!stats.empty()) std::cout << "  " << stats.summary() << std::endl;
+    }
+
+    // Compare a working-tree file, whose contents hash to hash, against the
+    // staging manifest and the current commit
+    void calculateFileStatus(const std::string& relativePath, const std::optional<Digest>& hash,
+                             const FileMap& commitFiles, const Index& index, FileStatus& status) {
+        auto staged = index.stagedEntries().find(relativePath);
+        bool existsInStaging = staged != index.stagedEntries().end();
+        auto committed = commitFiles.find(relativePath);
+        bool existsInCommit = committed != commitFiles.end();
+        status.isUntracked = !existsInStaging && !existsInCommit;
+        status.isStaged = existsInStaging;
+        status.hash = hash;
+        if (existsInStaging) {
+            status.isModified = status.hash != staged->second.hash;
+        } else if (existsInCommit) {
+            status.isModified = status.hash != committed->second.hash;
+        }
+    }
+
+    // A commit named by "HEAD", a branch or its id
+    std::string resolveCommit(const std::string& name) const {
+        std::string id = name == "HEAD" ? branchManager.getCurrentCommitId()
+                       : branchManager.branchExists(name) ? branchManager.getBranchCommit(name) : name;
+        if (id.empty() || !commitManager.commitExists(id)) {
+            throw std::runtime_error("Unknown commit: " + name);
+        }
+        return id;
+    }
+
+    // The files of the current commit with the staged manifest applied
+    FileMap stagedFiles(const Index& index) const {
+        FileMap files = commitManager.getCommitFiles(branchManager.getCurrentCommitId());
+        for (const auto& [path, entry] : index.stagedEntries()) files[path] = entry;
+        return files;
+    }
+
+    // A path to diff; a side's hash is unset where the path does not exist,
+    // and the new side is read from the working tree if inWorkingTree is set
+    struct DiffEntry {
+        std::string path;
+        std::optional<Digest> fromHash;
+        std::optional<Digest> toHash;
+        uint32_t fromMode;
+        uint32_t toMode;
+        bool inWorkingTree;
+    };
+
+    // Contents of one side of a diff, or nullopt if it is too large to
+    // load whole
+    std::optional<std::string> readDiffSide(const DiffEntry& entry, bool newSide, uint64_t bigFileThreshold) const {
+        const auto& hash = newSide ? entry.toHash : entry.fromHash;
+        if (!hash) return std::string();
+        if (newSide && entry.inWorkingTree) {
+            if (PathUtils::getFileSize(entry.path) > bigFileThreshold) return std::nullopt;
+            std::ifstream in(entry.path, std::ios::binary);
+            return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        }
+        if (commitManager.isChunkedObject(*hash)) return std::nullopt;
+        return commitManager.readObject(*hash);
+    }
+
+    void writeFileDiff(const DiffEntry& entry, uint64_t bigFileThreshold, bool color) const {
+        std::cout << (color ? YEL : "") << "diff --vcs a/" << entry.path << " b/" << entry.path
+                  << (color ? END : "") << "\n";
+        if (entry.fromHash && entry.toHash && entry.fromMode != entry.toMode) {
+            std::cout << "old mode " << std::oct << entry.fromMode << "\n"
+                      << "new mode " << entry.toMode << std::dec << "\n";
+        }
+        if (entry.fromHash == entry.toHash) return;
+        auto from = readDiffSide(entry, false, bigFileThreshold);
+        auto to = readDiffSide(entry, true, bigFileThreshold);
+        if (!from || !to) {
+            std::cout << "Large files a/" << entry.path << " and b/" << entry.path << " differ\n";
+            return;
         }
+        if (LineDiff::isBinary(*from) || LineDiff::isBinary(*to)) {
+            std::cout << "Binary files a/" << entry.path << " and b/" << entry.path << " differ\n";
+            return;
+        }
+        std::cout << "--- " << (entry.fromHash ? "a/" + entry.path : "/dev/null") << "\n";
+        std::cout << "+++ " << (entry.toHash ? "b/" + entry.path : "/dev/null") << "\n";
+        auto fromLines = LineDiff::splitLines(*from);
+        auto toLines = LineDiff::splitLines(*to);
+        UnifiedDiff::write(std::cout, fromLines, toLines, LineDiff::diff(fromLines, toLines), color);
     }
 
 public:
+    enum class DiffFormat { Patch, Stat, NameOnly };
+
+    // Show what changed between two commits, between a commit and the
+    // working tree, or with no commits between the staged files and the
+    // working tree, optionally limited to paths. Changed paths are found by
+    // hash (through the commit trees and the index's stat cache) without
+    // reading file data; Stat and NameOnly stop there. Patches read only the
+    // changed files, one at a time, and each is written as soon as it is
+    // ready.
+    void diff(const std::vector<std::string>& commits, const std::vector<std::string>& paths, DiffFormat format) {
+        checkInitialized();
+
+        bool allPaths = paths.empty();
+        std::vector<std::string> prefixes;
+        for (std::string path : paths) {
+            if (path.compare(0, 2, "./") == 0) path.erase(0, 2);
+            while (path.size() > 1 && path.back() == '/') path.pop_back();
+            if (path == "." || path.empty()) allPaths = true;
+            prefixes.push_back(path);
+        }
+        auto wanted = [&](const std::string& path) {
+            if (allPaths) return true;
+            for (const auto& prefix : prefixes) {
+                if (path.compare(0, prefix.size(), prefix) == 0 &&
+                    (path.size() == prefix.size() || path[prefix.size()] == '/')) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        // Read-only like status: hashes of working-tree files are not saved
+        if (format == DiffFormat::Patch && commitManager.hasLegacyData()) {
+            throw std::runtime_error("Some file data is still in the format of an earlier version; "
+                                     "run 'vcs migrate' first");
+        }
+        Index index;
+        std::vector<DiffEntry> entries;
+        if (commits.size() == 2) {
+            for (const auto& change : commitManager.diffCommits(resolveCommit(commits[0]), resolveCommit(commits[1]))) {
+                if (wanted(change.path)) {
+                    entries.push_back({change.path, change.fromHash, change.toHash, change.fromMode, change.toMode, false});
+                }
+            }
+        } else {
+            FileMap staged = stagedFiles(index);
+            FileMap from = commits.empty() ? staged : commitManager.getCommitFiles(resolveCommit(commits[0]));
+            std::set<std::string> tracked;
+            for (const auto& [path, _] : from) tracked.insert(path);
+            for (const auto& [path, _] : staged) tracked.insert(path);
+            std::vector<std::string> paths;
+            for (const auto& path : tracked) {
+                if (wanted(path)) paths.push_back(path);
+            }
+            auto hashes = index.hashFiles(paths);
+            for (size_t i = 0; i < paths.size(); ++i) {
+                auto it = from.find(paths[i]);
+                auto fromHash = it != from.end() ? std::optional<Digest>(it->second.hash) : std::nullopt;
+                uint32_t fromMode = it != from.end() ? it->second.mode : 0;
+                PathUtils::FileStat stat;
+                uint32_t toMode = hashes[i] && PathUtils::statFile(paths[i], stat) ? stat.mode : 0;
+                if (fromHash != hashes[i] || (fromHash && hashes[i] && fromMode != toMode)) {
+                    entries.push_back({paths[i], fromHash, hashes[i], fromMode, toMode, true});
+                }
+            }
+        }
+
+        if (format == DiffFormat::NameOnly) {
+            for (const auto& entry : entries) std::cout << entry.path << "\n";
+        } else if (format == DiffFormat::Stat) {
+            size_t added = 0, deleted = 0;
+            for (const auto& entry : entries) {
+                const char* kind = !entry.fromHash ? "added" : !entry.toHash ? "deleted" :
+                                   entry.fromHash == entry.toHash ? "mode changed" : "modified";
+                added += !entry.fromHash;
+                deleted += !entry.toHash;
+                std::cout << " " << entry.path << " | " << kind << "\n";
+            }
+            if (!entries.empty()) {
+                std::cout << " " << entries.size() << " file(s) changed, " << added << " added, "
+                          << entries.size() - added - deleted << " modified, " << deleted << " deleted\n";
+            }
+        } else {
+            uint64_t bigFileThreshold = RepoConfig::load().bigFileThreshold();
+            bool color = isatty(STDOUT_FILENO);
+            for (const auto& entry : entries) {
+                writeFileDiff(entry, bigFileThreshold, color);
+                std::cout.flush();
+            }
+        }
+        std::cout.flush();
+    }
+
     void init() {
         if (isInitialized()) {
             throw std::runtime_error("Repository already initialized");
         }
 
         PathUtils::createDirectory(".vcs");
-        PathUtils::createDirectory(".vcs/staging_area");
         PathUtils::createDirectory(".vcs/commits");
+        PathUtils::createDirectory(".vcs/objects");
         
         branchManager.createBranch("main");
+        persist();
         std::cout << GRN "Initialized empty VCS repository" END << std::endl;
     }
 
-    void add(const std::string& path = ".") {
+    // Store the files under each path and stage them for the next commit.
+    // jobs is the number of hash/compress workers; 0 takes core.workers from
+    // .vcs/config, which defaults to one per hardware thread.
+    void add(const std::vector<std::string>& paths, size_t jobs = 0) {
         checkInitialized();
 
-        if (path == ".") {
-            for (const auto& entry : PathUtils::listDirectory(PathUtils::getCurrentPath())) {
-                if (entry != ".vcs") {
-                    std::string fullPath = PathUtils::joinPath(PathUtils::getCurrentPath(), entry);
-                    if (PathUtils::isDirectory(fullPath)) {
-                        PathUtils::copyDirectory(fullPath, PathUtils::joinPath(".vcs", "staging_area", entry));
-                    } else {
-                        PathUtils::copyFile(fullPath, PathUtils::joinPath(".vcs", "staging_area", entry));
-                    }
-                }
+        Index index = openIndex();
+        IgnoreRules ignore = IgnoreRules::load(".vcsignore");
+        if (jobs == 0) jobs = RepoConfig::load().workers();
+        for (const auto& path : paths) {
+            if (path == ".") {
+                stageFiles(DirWalker::listFiles(".", &ignore), index, jobs);
+                index.pruneUnseen();  // every tracked path was just looked up
+                std::cout << GRN "Added all files to staging area" END << std::endl;
+                continue;
             }
-            std::cout << GRN "Added all files to staging area" END << std::endl;
-        } else {
             if (!PathUtils::exists(path)) {
                 throw std::runtime_error("Path does not exist: " + path);
             }
-
-            std::string targetPath = PathUtils::joinPath(".vcs", "staging_area", path);
+            std::string relativePath = path;
+            if (relativePath.compare(0, 2, "./") == 0) relativePath.erase(0, 2);
             if (PathUtils::isDirectory(path)) {
-                PathUtils::copyDirectory(path, targetPath);
+                while (relativePath.size() > 1 && relativePath.back() == '/') relativePath.pop_back();
+                if (DirWalker::isMetadataPath(relativePath)) {
+                    throw std::runtime_error("Cannot stage repository metadata: " + path);
+                }
+                stageFiles(DirWalker::listFiles(".", &ignore, relativePath), index, jobs);
             } else {
-                PathUtils::copyFile(path, targetPath);
+                stageFiles({relativePath}, index, jobs);
             }
             std::cout << GRN "Added '" << path << "' to staging area" END << std::endl;
         }
+        persist(&index);
+        reportCopyStats(commitManager.takeCopyStats());
     }
 
+    // Record the staged manifest as a commit. The blobs were stored by add,
+    // so this reads no file data.
     void commit(const std::string& message) {
         checkInitialized();
         
@@ -105,16 +362,20 @@ public:
             throw std::runtime_error("Commit message cannot be empty");
         }
 
+        Index index = openIndex();
+        std::string parentId = branchManager.getCurrentCommitId();
+        std::vector<std::string> parents;
+        if (!parentId.empty()) parents.push_back(parentId);
         std::string commitId = commitManager.createCommit(
             message, 
-            branchManager.getCurrentBranch()
+            branchManager.getCurrentBranch(),
+            parents,
+            index.stagedEntries()
         );
         
         branchManager.updateBranchCommit(commitId);
-        
-        // Clear staging area
-        PathUtils::removeDirectory(PathUtils::joinPath(".vcs", "staging_area"));
-        PathUtils::createDirectory(PathUtils::joinPath(".vcs", "staging_area"));
+        index.clearStaged();
+        persist(&index);
         
         std::cout << GRN "Created commit " << commitId << END << std::endl;
     }
@@ -122,20 +383,28 @@ public:
     void status() {
         checkInitialized();
         fileStatuses.clear();
-        std::vector<std::string> allFiles = PathUtils::listRecursiveDirectory(PathUtils::getCurrentPath());
-        for (const auto& filePath : allFiles) {
-            std::string relativePath = PathUtils::getRelativePath(filePath, PathUtils::getCurrentPath());
-            if (relativePath.find(".vcs") == 0) continue;
-            FileStatus status = {false, false, true, ""};
-            calculateFileStatus(filePath, status);
-            fileStatuses[relativePath] = status;
+        // Any legacy staging area is left for the next command that writes.
+        // The refreshed stat cache is saved if the index is free, so files
+        // that had to be read are not read again by the next status.
+        Index index;
+        FileMap commitFiles = commitManager.getCommitFiles(branchManager.getCurrentCommitId());
+        IgnoreRules ignore = IgnoreRules::load(".vcsignore");
+        // Hashed through the index, so files whose stat data is unchanged
+        // are not read again and the rest are read concurrently
+        auto files = DirWalker::listFiles(".", &ignore);
+        auto hashes = index.hashFiles(files);
+        for (size_t i = 0; i < files.size(); ++i) {
+            FileStatus status = {false, false, true, std::nullopt};
+            calculateFileStatus(files[i], hashes[i], commitFiles, index, status);
+            fileStatuses[files[i]] = status;
         }
+        saveStatCache(index);
         std::cout << "On branch " << branchManager.getCurrentBranch() << "\n\n";
         bool hasStaged = false;
         std::cout << GRN "Changes to be committed:" END << std::endl;
         for (const auto& [path, status] : fileStatuses) {
             if (status.isStaged) {
-                std::cout << GRN "\tmodified: " << path << END << std::endl;
+                std::cout << GRN "\tmodified: " << path << END "\n";
                 hasStaged = true;
             }
         }
@@ -144,7 +413,7 @@ public:
         std::cout << "\n" RED "Changes not staged for commit:" END << std::endl;
         for (const auto& [path, status] : fileStatuses) {
             if (status.isModified && !status.isUntracked) {
-                std::cout << RED "\tmodified: " << path << END << std::endl;
+                std::cout << RED "\tmodified: " << path << END "\n";
                 hasModified = true;
             }
         }
@@ -153,7 +422,7 @@ public:
         std::cout << "\n" YEL "Untracked files:" END << std::endl;
         for (const auto& [path, status] : fileStatuses) {
             if (status.isUntracked) {
-                std::cout << YEL "\t" << path << END << std::endl;
+                std::cout << YEL "\t" << path << END "\n";
                 hasUntracked = true;
             }
         }
@@ -163,7 +432,7 @@ public:
     void log() {
         checkInitialized();
         
-        auto history = commitManager.getCommitHistory();
+        auto history = commitManager.getCommitHistory(branchManager.getCurrentCommitId());
         if (history.empty()) {
             std::cout << "No commits yet" << std::endl;
             return;
@@ -196,6 +465,7 @@ public:
             }
         } else {
             if (branchManager.createBranch(name, branchManager.getCurrentCommitId())) {
+                persist();
                 std::cout << GRN "Created branch '" << name << "'" END << std::endl;
             } else {
                 throw std::runtime_error("Could not create branch");
@@ -203,36 +473,96 @@ public:
         }
     }
 
-    void checkout(const std::string& branchName) {
+    // Switch branches, touching only the files that differ between the two
+    // commits. Refuses to run if that would overwrite local changes, unless
+    // force is set.
+    void checkout(const std::string& branchName, bool force = false) {
         checkInitialized();
         
         if (!branchManager.branchExists(branchName)) {
             throw std::runtime_error("Branch does not exist");
         }
 
-        if (branchManager.switchBranch(branchName)) {
-            std::string commitId = branchManager.getCurrentCommitId();
-            if (!commitId.empty()) {
-                // Clear working directory (except .git)
-                for (const auto& entry : PathUtils::listDirectory(PathUtils::getCurrentPath())) {
-                    if (entry != ".vcs") {
-                        std::string fullPath = PathUtils::joinPath(PathUtils::getCurrentPath(), entry);
-                        if (PathUtils::isDirectory(fullPath)) {
-                            PathUtils::removeDirectory(fullPath);
-                        } else {
-                            PathUtils::removeFile(fullPath);
-                        }
+        std::string fromId = branchManager.getCurrentCommitId();
+        std::string toId = branchManager.getBranchCommit(branchName);
+        size_t written = 0;
+        size_t removed = 0;
+        Index index = openIndex();
+        if (!toId.empty()) {
+            auto changes = commitManager.diffCommits(fromId, toId);
+            std::vector<std::string> changedPaths;
+            for (const auto& change : changes) changedPaths.push_back(change.path);
+            auto workingHashes = index.hashFiles(changedPaths);
+            std::unordered_set<std::string> removedPaths;
+            for (const auto& change : changes) {
+                if (!change.toHash) removedPaths.insert(change.path);
+            }
+            std::vector<std::string> obstacles;  // untracked entries in the way of new files
+            std::string conflicts;
+            for (size_t i = 0; i < changes.size(); ++i) {
+                const auto& change = changes[i];
+                if (workingHashes[i] && workingHashes[i] != change.fromHash && workingHashes[i] != change.toHash) {
+                    conflicts += "\n\t" + change.path;
+                }
+                if (!change.toHash) continue;
+                std::string obstacle = PathUtils::isDirectory(change.path) ? change.path : "";
+                for (std::string dir = PathUtils::getDirectory(change.path); obstacle.empty() && !dir.empty();
+                     dir = PathUtils::getDirectory(dir)) {
+                    if (PathUtils::exists(dir) && !PathUtils::isDirectory(dir) && !removedPaths.count(dir)) {
+                        obstacle = dir;
                     }
                 }
-
-                // Restore files from commit
-                commitManager.restoreCommit(commitId, PathUtils::getCurrentPath());
+                if (!obstacle.empty()) {
+                    conflicts += "\n\t" + obstacle + " (untracked, in the way of " + change.path + ")";
+                    obstacles.push_back(obstacle);
+                }
             }
-            
-            std::cout << GRN "Switched to branch '" << branchName << "'" END << std::endl;
-        } else {
+            if (!conflicts.empty() && !force) {
+                throw std::runtime_error("Local changes to these files would be overwritten by checkout:" +
+                    conflicts + "\nCommit them first, or use 'vcs checkout -f " + branchName + "' to discard them");
+            }
+            for (const auto& obstacle : obstacles) {
+                if (PathUtils::isDirectory(obstacle)) PathUtils::removeDirectory(obstacle);
+                else PathUtils::removeFile(obstacle);
+            }
+            // Files written here are recorded in the index with their new
+            // stat data, so the next status does not read them again
+            for (size_t i = 0; i < changes.size(); ++i) {
+                const auto& change = changes[i];
+                if (!change.toHash) {
+                    index.forget(change.path);
+                    if (PathUtils::removeFile(change.path)) {
+                        PathUtils::removeEmptyParents(change.path);
+                        ++removed;
+                    }
+                    continue;
+                }
+                if (workingHashes[i] != change.toHash) {
+                    if (!commitManager.restoreFile(*change.toHash, change.path, change.toMode)) {
+                        throw std::runtime_error("Could not write " + change.path);
+                    }
+                } else if (change.fromMode != change.toMode) {
+                    if (chmod(change.path.c_str(), change.toMode) != 0) {
+                        throw std::runtime_error("Could not change the mode of " + change.path);
+                    }
+                } else {
+                    continue;
+                }
+                ++written;
+                PathUtils::FileStat stat;
+                if (PathUtils::statFile(change.path, stat)) index.record(change.path, stat, *change.toHash);
+            }
+        }
+
+        if (!branchManager.switchBranch(branchName)) {
             throw std::runtime_error("Could not switch branch");
         }
+        persist(&index);
+        std::cout << GRN "Switched to branch '" << branchName << "'" END << std::endl;
+        if (written || removed) {
+            std::cout << written << " file(s) updated, " << removed << " removed" << std::endl;
+        }
+        reportCopyStats(commitManager.takeCopyStats());
     }
 
     void merge(const std::string& sourceBranch) {
@@ -246,20 +576,112 @@ public:
             throw std::runtime_error("Branch does not exist");
         }
 
+        std::string sourceCommit = branchManager.getBranchCommit(sourceBranch);
+        if (sourceCommit.empty() || commitManager.isAncestor(sourceCommit, branchManager.getCurrentCommitId())) {
+            std::cout << YEL "Already up to date with '" << sourceBranch << "'" END << std::endl;
+            return;
+        }
+
+        Index index = openIndex();
         std::string commitId = commitManager.createMergeCommit(
             "Merge branch '" + sourceBranch + "'",
             branchManager.getCurrentBranch(),
-            branchManager.getBranchCommit(sourceBranch),
+            sourceBranch,
+            sourceCommit,
             branchManager.getCurrentCommitId()
         );
 
         branchManager.updateBranchCommit(commitId);
+        persist(&index);
         
-        // Update working directory
-        commitManager.restoreCommit(commitId, PathUtils::getCurrentPath());
+        // Update working directory, then save the stat data of what was written
+        commitManager.restoreCommit(commitId, PathUtils::getCurrentPath(), &index);
+        persist(&index);
         
         std::cout << GRN "Merged branch '" << sourceBranch << "' into '" 
                   << branchManager.getCurrentBranch() << "'" END << std::endl;
+        for (const auto& path : commitManager.takeMergeConflicts()) {
+            std::cout << YEL "Conflict in " << path << END << std::endl;
+        }
+        reportCopyStats(commitManager.takeCopyStats());
+    }
+
+    // Move what earlier versions kept under .vcs into the current formats.
+    // Every writing command does this too; this does nothing else.
+    void migrate() {
+        checkInitialized();
+
+        Index index;
+        migrateStagingArea(index);
+        size_t commits = commitManager.migrateLegacyData();
+        persist(&index);
+        if (commits == 0) {
+            std::cout << "Nothing to migrate" << std::endl;
+            return;
+        }
+        std::cout << GRN "Moved the file data of " << commits << " commit(s) into the object store" END << std::endl;
+    }
+
+    void repack() {
+        checkInitialized();
+
+        auto stats = commitManager.repackObjects();
+        if (stats.objects == 0) {
+            std::cout << "Nothing to repack" << std::endl;
+            return;
+        }
+        std::cout << GRN "Packed " << stats.objects << " objects ("
+                  << stats.looseBytes << " bytes loose -> "
+                  << stats.packBytes << " bytes packed)" END << std::endl;
+    }
+
+    // Delete the objects no branch or staged file reaches once they are older
+    // than the grace period (at once with pruneNow), pack the rest in the
+    // order they are read, and drop what earlier versions left under .vcs
+    void gc(bool pruneNow) {
+        checkInitialized();
+        using Clock = std::chrono::steady_clock;
+        auto millis = [](Clock::time_point since) {
+            return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+        };
+        Index index = openIndex();
+        uint64_t leftoverBytes = 0;
+        for (const char* name : {"commits", "merge_temp"}) {
+            std::string path = PathUtils::joinPath(".vcs", name);
+            if (!PathUtils::isDirectory(path)) continue;
+            leftoverBytes += PathUtils::getDirectorySize(path);
+            transaction.remove(path);
+        }
+
+        auto markStart = Clock::now();
+        std::vector<std::string> tips;
+        for (const auto& name : branchManager.getAllBranches()) tips.push_back(branchManager.getBranchCommit(name));
+        std::map<std::string, Digest> stagedByPath;
+        for (const auto& [path, entry] : index.stagedEntries()) stagedByPath[path] = entry.hash;
+        std::vector<Digest> staged;
+        for (const auto& [path, hash] : stagedByPath) staged.push_back(hash);
+        auto reachable = commitManager.reachableObjects(tips, staged);
+        double markMs = millis(markStart);
+
+        auto packStart = Clock::now();
+        int64_t keepSince = pruneNow ? INT64_MAX
+            : static_cast<int64_t>(std::time(nullptr)) - static_cast<int64_t>(RepoConfig::load().gcGraceSeconds());
+        auto stats = commitManager.collectGarbage(reachable, keepSince);
+        double packMs = millis(packStart);
+        persist(&index);
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Marked " << stats.packed + stats.loose << " reachable objects from " << tips.size()
+                  << " branch(es) in " << markMs << " ms" << std::endl;
+        std::cout << "Removed " << stats.removed << " unreachable objects, kept " << stats.recent
+                  << " written within the grace period" << std::endl;
+        std::cout << "Packed " << stats.packed << " objects (" << stats.loose << " left loose) in "
+                  << packMs << " ms" << std::endl;
+        if (leftoverBytes > 0) {
+            std::cout << "Removed " << leftoverBytes << " bytes left by earlier versions" << std::endl;
+        }
+        std::cout << GRN "Object store: " << stats.bytesBefore << " bytes on disk -> " << stats.bytesAfter
+                  << " bytes" END << std::endl;
     }
 
     void revert(const std::string& commitId) {
@@ -272,18 +694,22 @@ public:
             throw std::runtime_error("Commit does not exist");
         }
 
+        Index index = openIndex();
         std::string newCommitId = commitManager.createCommit(
             "Revert to " + targetCommitId,
             branchManager.getCurrentBranch(),
-            {branchManager.getCurrentCommitId()}
+            {branchManager.getCurrentCommitId()},
+            index.stagedEntries()
         );
-
-        // Restore the files from target commit
-        commitManager.restoreCommit(targetCommitId, PathUtils::getCurrentPath());
-        
-        // Update branch
+        index.clearStaged();
         branchManager.updateBranchCommit(newCommitId);
+        persist(&index);
+
+        // Restore the files from target commit, then save their stat data
+        commitManager.restoreCommit(targetCommitId, PathUtils::getCurrentPath(), &index);
+        persist(&index);
         
         std::cout << GRN <<"Reverted to commit " << targetCommitId << END << std::endl;
+        reportCopyStats(commitManager.takeCopyStats());
     }
 };
\ No newline at end of file
@@ -1,40 +1,28 @@
 #pragma once
 #include <string>
-#include <vector>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
+// A branch is a name and the id of its tip commit; its history is whatever
+// the tip's ancestors are
 class Branch {
 public:
     std::string name;
     std::string currentCommitId;
-    std::vector<std::string> commitHistory;
 
     Branch(const std::string& branchName, const std::string& initialCommit = "")
         : name(branchName)
-        , currentCommitId(initialCommit) {
-        if (!initialCommit.empty()) {
-            commitHistory.push_back(initialCommit);
-        }
-    }
-
-    void addCommit(const std::string& commitId) {
-        currentCommitId = commitId;
-        commitHistory.push_back(commitId);
-    }
+        , currentCommitId(initialCommit) {}
 
     json toJson() const {
         return {
             {"name", name},
-            {"currentCommitId", currentCommitId},
-            {"commitHistory", commitHistory}
+            {"currentCommitId", currentCommitId}
         };
     }
 
     static Branch fromJson(const json& j) {
-        Branch branch(j["name"], j["currentCommitId"]);
-        branch.commitHistory = j["commitHistory"].get<std::vector<std::string>>();
-        return branch;
+        return Branch(j["name"], j["currentCommitId"]);
     }
-};
\ No newline at end of file
+};
@@ -1,9 +1,14 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
+#include <algorithm>
+#include <cstring>
 #include "../utils/hashUtils.hpp"
+#include "../utils/binaryIO.hpp"
+#include "manifest.hpp"
 
 class Commit {
 public:
@@ -13,40 +18,136 @@ public:
     std::string timestamp;
     std::string branch;
     std::vector<std::string> parentIds;
-    std::unordered_map<std::string, std::string> fileHashes;  // filepath -> hash
+    std::string treeHash;  // root tree; "" for commits made before trees, which list their files
+    Manifest files;        // every file, for commits without a tree
+
+    static constexpr uint32_t DEFAULT_MODE = 0644;
 
     Commit(const std::string& msg, const std::string& branchName, 
            const std::vector<std::string>& parents = {})
-        : id(HashUtils::generateId())
-        , message(msg)
+        : message(msg)
         , author("system")
         , timestamp(HashUtils::getCurrentTimestamp())
         , branch(branchName)
         , parentIds(parents) {}
 
-    void addFile(const std::string& path, const std::string& hash) {
-        fileHashes[path] = hash;
-    }
-
-    bool hasFile(const std::string& path) const {
-        return fileHashes.find(path) != fileHashes.end();
-    }
-
-    std::string getFileHash(const std::string& path) const {
-        auto it = fileHashes.find(path);
-        return it != fileHashes.end() ? it->second : "";
+    // SHA-256 of the tree, parents and metadata. Commits made before trees
+    // existed keep the random ids they were given.
+    std::string contentId() const {
+        std::string text = "tree " + treeHash + "\n";
+        for (const auto& parent : parentIds) text += "parent " + parent + "\n";
+        text += "author " + author + "\ntimestamp " + timestamp + "\nbranch " + branch + "\n\n" + message;
+        return HashUtils::computeSHA256(text);
     }
 
     json toJson() const {
-        return {
+        json j = {
             {"id", id},
             {"message", message},
             {"author", author},
             {"timestamp", timestamp},
             {"branch", branch},
-            {"parentIds", parentIds},
-            {"fileHashes", fileHashes}
+            {"parentIds", parentIds}
+        };
+        json hashes = json::object();
+        json modes = json::object();
+        files.forEach([&](std::string_view path, const Manifest::Entry& entry) {
+            hashes[std::string(path)] = entry.hash.hex();
+            if (entry.mode != DEFAULT_MODE) modes[std::string(path)] = entry.mode;
+        });
+        j["fileHashes"] = hashes;
+        if (!modes.empty()) j["fileModes"] = modes;
+        if (!treeHash.empty()) j["tree"] = treeHash;
+        return j;
+    }
+
+    // Binary record body used by the commit log:
+    //
+    //   id slot | parent count varint | parent slots | author | timestamp |
+    //   branch | message | file count varint | files sorted by path | [tree hash[32]]
+    //   string: length varint | bytes
+    //   file: path string | mode varint | hash[32]
+    //
+    // Commits with a tree list no files; older ones list every file and
+    // have no tree hash.
+    //
+    // Ids take a fixed ID_SLOT_SIZE bytes: a kind byte, then either the 32-byte
+    // binary form of a hex digest or a shorter text id padded with zeros.
+    static constexpr size_t ID_SLOT_SIZE = 33;
+
+    static void putId(std::string& out, const std::string& commitId) {
+        if (HashUtils::isHexDigest(commitId)) {
+            out += '\0';
+            out += HashUtils::hexToBinary(commitId);
+            return;
+        }
+        if (commitId.size() > ID_SLOT_SIZE - 1) throw std::runtime_error("Commit id too long: " + commitId);
+        out += '\1';
+        out += commitId;
+        out.append(ID_SLOT_SIZE - 1 - commitId.size(), '\0');
+    }
+
+    static std::string getId(const unsigned char* p) {
+        if (p[0] == 0) return HashUtils::binaryToHex(p + 1, ID_SLOT_SIZE - 1);
+        const char* text = reinterpret_cast<const char*>(p + 1);
+        return std::string(text, strnlen(text, ID_SLOT_SIZE - 1));
+    }
+
+    std::string encode() const {
+        std::string out;
+        putId(out, id);
+        BinaryIO::putVarint(out, parentIds.size());
+        for (const auto& parent : parentIds) putId(out, parent);
+        for (const std::string* field : {&author, &timestamp, &branch, &message}) putString(out, *field);
+        BinaryIO::putVarint(out, files.size());
+        files.forEach([&](std::string_view path, const Manifest::Entry& entry) {
+            BinaryIO::putVarint(out, path.size());
+            out.append(path);
+            BinaryIO::putVarint(out, entry.mode);
+            out.append(reinterpret_cast<const char*>(entry.hash.data()), HashUtils::DIGEST_SIZE);
+        });
+        if (!treeHash.empty()) out += HashUtils::hexToBinary(treeHash);
+        return out;
+    }
+
+    static Commit decode(const unsigned char* p, size_t length) {
+        const unsigned char* end = p + length;
+        auto need = [&](size_t bytes) {
+            if (static_cast<size_t>(end - p) < bytes) throw std::runtime_error("Truncated commit record");
         };
+        need(ID_SLOT_SIZE);
+        std::string commitId = getId(p);
+        p += ID_SLOT_SIZE;
+        std::vector<std::string> parents(BinaryIO::getVarint(p, end));
+        need(parents.size() * ID_SLOT_SIZE);
+        for (auto& parent : parents) {
+            parent = getId(p);
+            p += ID_SLOT_SIZE;
+        }
+        std::string author = getString(p, end);
+        std::string timestamp = getString(p, end);
+        std::string branchName = getString(p, end);
+        Commit commit(getString(p, end), branchName, parents);
+        commit.id = commitId;
+        commit.author = author;
+        commit.timestamp = timestamp;
+        uint64_t count = BinaryIO::getVarint(p, end);
+        commit.files.reserve(std::min<uint64_t>(count, end - p), end - p);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t pathLength = BinaryIO::getVarint(p, end);
+            need(pathLength);
+            std::string_view path(reinterpret_cast<const char*>(p), pathLength);
+            p += pathLength;
+            uint32_t mode = static_cast<uint32_t>(BinaryIO::getVarint(p, end));
+            need(HashUtils::DIGEST_SIZE);
+            Digest hash;
+            std::memcpy(hash.bytes.data(), p, HashUtils::DIGEST_SIZE);
+            p += HashUtils::DIGEST_SIZE;
+            commit.files.add(path, mode, hash);
+        }
+        commit.files.sort();
+        if (end - p >= static_cast<ptrdiff_t>(HashUtils::DIGEST_SIZE)) commit.treeHash = HashUtils::binaryToHex(p, HashUtils::DIGEST_SIZE);
+        return commit;
     }
 
     static Commit fromJson(const json& j) {
@@ -55,7 +156,28 @@ public:
         commit.author = j["author"];
         commit.timestamp = j["timestamp"];
         commit.parentIds = j["parentIds"].get<std::vector<std::string>>();
-        commit.fileHashes = j["fileHashes"].get<std::unordered_map<std::string, std::string>>();
+        commit.treeHash = j.value("tree", "");
+        auto modes = j.value("fileModes", std::unordered_map<std::string, uint32_t>());
+        for (const auto& [path, hash] : j["fileHashes"].items()) {
+            auto mode = modes.find(path);
+            commit.files.add(path, mode != modes.end() ? mode->second : DEFAULT_MODE,
+                             Digest::fromHex(hash.get<std::string>()));
+        }
+        commit.files.sort();
         return commit;
     }
+
+private:
+    static void putString(std::string& out, const std::string& text) {
+        BinaryIO::putVarint(out, text.size());
+        out += text;
+    }
+
+    static std::string getString(const unsigned char*& p, const unsigned char* end) {
+        uint64_t length = BinaryIO::getVarint(p, end);
+        if (length > static_cast<uint64_t>(end - p)) throw std::runtime_error("Truncated commit record");
+        std::string text(reinterpret_cast<const char*>(p), length);
+        p += length;
+        return text;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "../utils/hashUtils.hpp"
+
+// The file list of a commit made before trees existed: a flat array of
+// (path, mode, digest) entries sorted by path and looked up by binary
+// search. The paths are kept back to back in one buffer owned by the
+// manifest, so a list of n files costs two allocations rather than n.
+class Manifest {
+public:
+    struct Entry {
+        uint32_t mode;
+        Digest hash;
+    };
+
+private:
+    struct Slot {
+        uint32_t pathOffset;
+        uint32_t pathLength;
+        Entry entry;
+    };
+
+    std::string paths;
+    std::vector<Slot> slots;
+
+    std::string_view pathOf(const Slot& slot) const {
+        return std::string_view(paths).substr(slot.pathOffset, slot.pathLength);
+    }
+
+public:
+    void reserve(size_t files, size_t pathBytes) {
+        slots.reserve(files);
+        paths.reserve(pathBytes);
+    }
+
+    // Add a file; call sort() once everything is added
+    void add(std::string_view path, uint32_t mode, const Digest& hash) {
+        slots.push_back({static_cast<uint32_t>(paths.size()), static_cast<uint32_t>(path.size()), {mode, hash}});
+        paths.append(path);
+    }
+
+    // Order the entries by path; for a repeated path the last one added wins.
+    // Lists read back from the commit log are already sorted.
+    void sort() {
+        auto less = [this](const Slot& a, const Slot& b) { return pathOf(a) < pathOf(b); };
+        auto outOfOrder = [&](const Slot& a, const Slot& b) { return !less(a, b); };
+        if (std::adjacent_find(slots.begin(), slots.end(), outOfOrder) == slots.end()) return;
+        std::stable_sort(slots.begin(), slots.end(), less);
+        std::vector<Slot> unique;
+        unique.reserve(slots.size());
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (i + 1 < slots.size() && pathOf(slots[i + 1]) == pathOf(slots[i])) continue;
+            unique.push_back(slots[i]);
+        }
+        slots = std::move(unique);
+    }
+
+    size_t size() const { return slots.size(); }
+    bool empty() const { return slots.empty(); }
+
+    const Entry* find(std::string_view path) const {
+        auto it = std::lower_bound(slots.begin(), slots.end(), path,
+                                   [this](const Slot& slot, std::string_view key) { return pathOf(slot) < key; });
+        return it != slots.end() && pathOf(*it) == path ? &it->entry : nullptr;
+    }
+
+    // Visit every entry with its path, in path order
+    void forEach(const std::function<void(std::string_view path, const Entry& entry)>& fn) const {
+        for (const auto& slot : slots) fn(pathOf(slot), slot.entry);
+    }
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include "../utils/hashUtils.hpp"
+#include "../utils/binaryIO.hpp"
+
+// A tracked file: blob digest and permission bits
+struct FileEntry {
+    Digest hash;
+    uint32_t mode = 0644;
+};
+
+// Every file of a snapshot by path
+using FileMap = std::unordered_map<std::string, FileEntry>;
+
+struct TreeEntry {
+    std::string name;
+    uint32_t mode;     // permission bits, or Tree::TREE_MODE for a subdirectory
+    Digest hash;       // blob or tree hash
+
+    bool isTree() const;
+};
+
+// One directory of a snapshot, stored as an object named by the SHA-256 of
+// its encoding, so a directory's hash covers everything below it:
+//
+//   entry count varint | entries sorted by name
+//   entry: name length varint | name | mode varint | hash[32]
+class Tree {
+public:
+    static constexpr uint32_t TREE_MODE = 040000;
+    static constexpr size_t HASH_SIZE = Digest::SIZE;
+
+    std::vector<TreeEntry> entries;
+
+    void sort() {
+        std::sort(entries.begin(), entries.end(),
+                  [](const TreeEntry& a, const TreeEntry& b) { return a.name < b.name; });
+    }
+
+    const TreeEntry* find(const std::string& name) const {
+        auto it = std::lower_bound(entries.begin(), entries.end(), name,
+                                   [](const TreeEntry& entry, const std::string& key) { return entry.name < key; });
+        return it != entries.end() && it->name == name ? &*it : nullptr;
+    }
+
+    std::string encode() const {
+        std::string out;
+        BinaryIO::putVarint(out, entries.size());
+        for (const auto& entry : entries) {
+            BinaryIO::putVarint(out, entry.name.size());
+            out += entry.name;
+            BinaryIO::putVarint(out, entry.mode);
+            out.append(reinterpret_cast<const char*>(entry.hash.data()), HASH_SIZE);
+        }
+        return out;
+    }
+
+    static Tree decode(const std::string& data) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+        const unsigned char* end = p + data.size();
+        Tree tree;
+        tree.entries.resize(BinaryIO::getVarint(p, end));
+        for (auto& entry : tree.entries) {
+            uint64_t length = BinaryIO::getVarint(p, end);
+            if (length > static_cast<uint64_t>(end - p)) throw std::runtime_error("Corrupt tree object");
+            entry.name.assign(reinterpret_cast<const char*>(p), length);
+            p += length;
+            entry.mode = static_cast<uint32_t>(BinaryIO::getVarint(p, end));
+            if (end - p < static_cast<ptrdiff_t>(HASH_SIZE)) throw std::runtime_error("Corrupt tree object");
+            std::memcpy(entry.hash.bytes.data(), p, HASH_SIZE);
+            p += HASH_SIZE;
+        }
+        return tree;
+    }
+};
+
+inline bool TreeEntry::isTree() const { return mode == Tree::TREE_MODE; }
@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+// Fixed-width little-endian encoding helpers for the binary on-disk formats
+class BinaryIO {
+public:
+    static void putU32(std::string& out, uint32_t value) {
+        for (int i = 0; i < 4; ++i) out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+
+    static void putU64(std::string& out, uint64_t value) {
+        for (int i = 0; i < 8; ++i) out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+
+    static uint32_t getU32(const unsigned char* p) {
+        uint32_t value = 0;
+        for (int i = 3; i >= 0; --i) value = (value << 8) | p[i];
+        return value;
+    }
+
+    static uint64_t getU64(const unsigned char* p) {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; --i) value = (value << 8) | p[i];
+        return value;
+    }
+
+    // LEB128-style variable-length unsigned integer
+    static void putVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    // CRC-32 (IEEE) of a byte range, for detecting torn or corrupted records
+    static uint32_t crc32(const unsigned char* data, size_t length) {
+        static const auto table = [] {
+            struct Table { uint32_t entries[256]; } t;
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t.entries[i] = c;
+            }
+            return t;
+        }();
+        uint32_t crc = 0xffffffffu;
+        for (size_t i = 0; i < length; ++i) crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return crc ^ 0xffffffffu;
+    }
+
+    // Read a varint and advance p; throws if it runs past end
+    static uint64_t getVarint(const unsigned char*& p, const unsigned char* end) {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) throw std::runtime_error("Truncated varint");
+            unsigned char byte = *p++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("Malformed varint");
+    }
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include "huffmanCoder.hpp"
+#include "lzCoder.hpp"
+
+// Compression codecs for stored blobs. Every codec has a one-byte id that is
+// written into the object header, so objects written with different codecs
+// can live side by side and new codecs can be added without a format change.
+enum class CodecId : uint8_t {
+    Stored = 0,   // raw bytes
+    Huffman = 1,  // order-0 Huffman
+    Lz = 2,       // LZ77 matches, then Huffman
+};
+
+class Codec {
+public:
+    virtual ~Codec() = default;
+    virtual CodecId id() const = 0;
+    virtual const char* name() const = 0;
+    virtual std::string encode(const std::string& data) const = 0;
+    virtual std::string decode(const std::string& payload) const = 0;
+
+    // Bytes [offset, offset + length) of the decoded data
+    virtual std::string decodeRange(const std::string& payload, uint64_t offset, uint64_t length) const {
+        std::string data = decode(payload);
+        return offset < data.size() ? data.substr(offset, length) : "";
+    }
+};
+
+class StoredCodec : public Codec {
+public:
+    CodecId id() const override { return CodecId::Stored; }
+    const char* name() const override { return "stored"; }
+    std::string encode(const std::string& data) const override { return data; }
+    std::string decode(const std::string& payload) const override { return payload; }
+    std::string decodeRange(const std::string& payload, uint64_t offset, uint64_t length) const override {
+        return offset < payload.size() ? payload.substr(offset, length) : "";
+    }
+};
+
+class HuffmanCodec : public Codec {
+public:
+    CodecId id() const override { return CodecId::Huffman; }
+    const char* name() const override { return "huffman"; }
+    std::string encode(const std::string& data) const override { return HuffmanCoder::compressData(data); }
+    std::string decode(const std::string& payload) const override { return HuffmanCoder::decompress(payload); }
+    std::string decodeRange(const std::string& payload, uint64_t offset, uint64_t length) const override {
+        return HuffmanCoder::decompressRange(payload, offset, length);
+    }
+};
+
+class LzCodec : public Codec {
+public:
+    CodecId id() const override { return CodecId::Lz; }
+    const char* name() const override { return "lz"; }
+    std::string encode(const std::string& data) const override {
+        return HuffmanCoder::compressData(LzCoder::encode(data));
+    }
+    std::string decode(const std::string& payload) const override {
+        return LzCoder::decode(HuffmanCoder::decompress(payload));
+    }
+};
+
+class Codecs {
+public:
+    // Sampled entropy (bits per byte) at or above which data is stored raw
+    static constexpr double INCOMPRESSIBLE_ENTROPY = 7.5;
+    static constexpr size_t SAMPLE_SIZE = 16 * 1024;
+    static constexpr size_t SAMPLE_COUNT = 4;
+
+    static const Codec& get(CodecId id) {
+        static const StoredCodec stored;
+        static const HuffmanCodec huffman;
+        static const LzCodec lz;
+        switch (id) {
+            case CodecId::Stored: return stored;
+            case CodecId::Huffman: return huffman;
+            case CodecId::Lz: return lz;
+        }
+        throw std::runtime_error("Unknown codec id " + std::to_string(static_cast<int>(id)));
+    }
+
+    static const Codec& get(uint8_t id) {
+        if (id > static_cast<uint8_t>(CodecId::Lz)) {
+            throw std::runtime_error("Unknown codec id " + std::to_string(id));
+        }
+        return get(static_cast<CodecId>(id));
+    }
+
+    // "auto" is not a codec; it is resolved per blob by choose()
+    static bool isValidName(const std::string& name) {
+        return name == "auto" || name == "stored" || name == "huffman" || name == "lz";
+    }
+
+    static const Codec& byName(const std::string& name) {
+        if (name == "stored") return get(CodecId::Stored);
+        if (name == "huffman") return get(CodecId::Huffman);
+        if (name == "lz") return get(CodecId::Lz);
+        throw std::runtime_error("Unknown codec: " + name);
+    }
+
+    // Shannon entropy of the byte histogram of a few slices spread over the
+    // data. Cheap enough to run on every blob.
+    static double sampleEntropy(const std::string& data) {
+        if (data.empty()) return 0.0;
+        uint64_t counts[256] = {};
+        uint64_t total = 0;
+        size_t stride = data.size() / SAMPLE_COUNT;
+        for (size_t s = 0; s < SAMPLE_COUNT; ++s) {
+            size_t begin = s * stride;
+            size_t end = std::min(data.size(), begin + SAMPLE_SIZE);
+            for (size_t i = begin; i < end; ++i) counts[static_cast<unsigned char>(data[i])]++;
+            total += end - begin;
+            if (stride == 0) break;
+        }
+        double entropy = 0.0;
+        for (uint64_t count : counts) {
+            if (count == 0) continue;
+            double p = static_cast<double>(count) / total;
+            entropy -= p * std::log2(p);
+        }
+        return entropy;
+    }
+
+    // Pick the codec for a blob given the configured name ("auto" or a codec)
+    static const Codec& choose(const std::string& data, const std::string& configured) {
+        if (configured != "auto") return byName(configured);
+        if (data.empty() || sampleEntropy(data) >= INCOMPRESSIBLE_ENTROPY) return get(CodecId::Stored);
+        return get(CodecId::Lz);
+    }
+};
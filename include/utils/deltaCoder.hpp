@@ -0,0 +1,130 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include "binaryIO.hpp"
+
+// Binary delta between two versions of a file, as a stream of copy/insert
+// instructions against the base:
+//
+//   baseSize varint | targetSize varint | instructions...
+//   INSERT: 0x00 | length varint | bytes
+//   COPY:   0x01 | baseOffset varint | length varint
+//
+// The encoder indexes the base in BLOCK-sized chunks and slides a rolling
+// hash over the target to find matches, which are then extended both ways.
+class DeltaCoder {
+public:
+    static constexpr size_t BLOCK = 16;
+
+    static std::string encode(const std::string& base, const std::string& target) {
+        std::string out;
+        BinaryIO::putVarint(out, base.size());
+        BinaryIO::putVarint(out, target.size());
+        if (base.size() < BLOCK || target.size() < BLOCK) {
+            emitInsert(out, target, 0, target.size());
+            return out;
+        }
+
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(base.data());
+        const unsigned char* t = reinterpret_cast<const unsigned char*>(target.data());
+        std::unordered_map<uint32_t, uint32_t> index;
+        index.reserve(base.size() / BLOCK);
+        for (size_t off = 0; off + BLOCK <= base.size(); off += BLOCK) {
+            index.emplace(hashBlock(b + off), static_cast<uint32_t>(off));
+        }
+
+        size_t pending = 0;  // start of bytes not yet emitted
+        size_t i = 0;
+        uint32_t h = hashBlock(t);
+        while (i + BLOCK <= target.size()) {
+            auto it = index.find(h);
+            if (it != index.end() && std::memcmp(b + it->second, t + i, BLOCK) == 0) {
+                size_t baseOff = it->second;
+                size_t targetOff = i;
+                size_t length = BLOCK;
+                while (targetOff > pending && baseOff > 0 && b[baseOff - 1] == t[targetOff - 1]) {
+                    --baseOff;
+                    --targetOff;
+                    ++length;
+                }
+                while (targetOff + length < target.size() && baseOff + length < base.size() &&
+                       b[baseOff + length] == t[targetOff + length]) {
+                    ++length;
+                }
+                emitInsert(out, target, pending, targetOff - pending);
+                out += static_cast<char>(OP_COPY);
+                BinaryIO::putVarint(out, baseOff);
+                BinaryIO::putVarint(out, length);
+                i = targetOff + length;
+                pending = i;
+                if (i + BLOCK <= target.size()) h = hashBlock(t + i);
+                continue;
+            }
+            if (i + BLOCK < target.size()) h = roll(h, t[i], t[i + BLOCK]);
+            ++i;
+        }
+        emitInsert(out, target, pending, target.size() - pending);
+        return out;
+    }
+
+    static std::string apply(const std::string& base, const std::string& delta) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(delta.data());
+        const unsigned char* end = p + delta.size();
+        uint64_t baseSize = BinaryIO::getVarint(p, end);
+        uint64_t targetSize = BinaryIO::getVarint(p, end);
+        if (baseSize != base.size()) throw std::runtime_error("Delta base size mismatch");
+
+        std::string out;
+        out.reserve(targetSize);
+        while (p < end) {
+            unsigned char op = *p++;
+            if (op == OP_INSERT) {
+                uint64_t length = BinaryIO::getVarint(p, end);
+                if (length > static_cast<uint64_t>(end - p)) throw std::runtime_error("Corrupt delta");
+                out.append(reinterpret_cast<const char*>(p), length);
+                p += length;
+            } else if (op == OP_COPY) {
+                uint64_t offset = BinaryIO::getVarint(p, end);
+                uint64_t length = BinaryIO::getVarint(p, end);
+                if (offset > base.size() || length > base.size() - offset) {
+                    throw std::runtime_error("Corrupt delta");
+                }
+                out.append(base, offset, length);
+            } else {
+                throw std::runtime_error("Corrupt delta");
+            }
+        }
+        if (out.size() != targetSize) throw std::runtime_error("Delta target size mismatch");
+        return out;
+    }
+
+private:
+    enum : unsigned char { OP_INSERT = 0x00, OP_COPY = 0x01 };
+    static constexpr uint32_t MULTIPLIER = 257;
+
+    static uint32_t hashBlock(const unsigned char* p) {
+        uint32_t h = 0;
+        for (size_t k = 0; k < BLOCK; ++k) h = h * MULTIPLIER + p[k];
+        return h;
+    }
+
+    // Slide the window one byte: drop `out`, append `in`
+    static uint32_t roll(uint32_t h, unsigned char out, unsigned char in) {
+        static const uint32_t outFactor = [] {
+            uint32_t f = 1;
+            for (size_t k = 1; k < BLOCK; ++k) f *= MULTIPLIER;
+            return f;
+        }();
+        return (h - out * outFactor) * MULTIPLIER + in;
+    }
+
+    static void emitInsert(std::string& out, const std::string& target, size_t from, size_t length) {
+        if (length == 0) return;
+        out += static_cast<char>(OP_INSERT);
+        BinaryIO::putVarint(out, length);
+        out.append(target, from, length);
+    }
+};
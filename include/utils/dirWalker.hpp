@@ -0,0 +1,138 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "ignoreRules.hpp"
+#include "threadPool.hpp"
+
+// Parallel directory walker. Each worker owns a queue of directories; it
+// takes work from the back of its own queue and steals from the front of the
+// others' when it runs dry, sleeping until more is queued if there is
+// nothing to steal. File types come from readdir's d_type, so only entries of
+// unknown type and symlinks cost an extra stat. Symlinks to files are listed;
+// symlinks to directories are not followed.
+class DirWalker {
+public:
+    // Sorted '/'-separated paths of the regular files under root/subdir,
+    // relative to root. Paths matched by ignore are skipped, and ignored
+    // directories are never opened. A ".vcs" directory directly under root is
+    // always skipped, and so is a subdir inside it.
+    static std::vector<std::string> listFiles(const std::string& root, const IgnoreRules* ignore = nullptr,
+                                              const std::string& subdir = "") {
+        if (isMetadataPath(subdir)) return {};
+        ThreadPool& pool = ThreadPool::shared();
+        size_t workers = pool.size() + 1;  // the calling thread works too
+        std::vector<WorkQueue> queues(workers);
+        std::vector<std::vector<std::string>> found(workers);
+        std::atomic<size_t> pending{1};  // directories queued or being scanned
+        std::atomic<size_t> queued{1};   // directories waiting in some queue
+        std::mutex idleMutex;
+        std::condition_variable idle;    // signalled when work is queued or all is done
+        auto wake = [&]() {
+            { std::lock_guard<std::mutex> lock(idleMutex); }
+            idle.notify_all();
+        };
+        queues[0].dirs.push_back(subdir);
+
+        pool.parallelFor(workers, [&](size_t self) {
+            std::vector<std::string> subdirs;
+            std::string dir;
+            for (;;) {
+                if (!takeWork(queues, self, dir)) {
+                    std::unique_lock<std::mutex> lock(idleMutex);
+                    idle.wait(lock, [&]() { return pending.load() == 0 || queued.load() > 0; });
+                    if (pending.load() == 0) return;
+                    continue;
+                }
+                queued -= 1;
+                subdirs.clear();
+                scanDirectory(root, dir, ignore, found[self], subdirs);
+                if (!subdirs.empty()) {
+                    pending += subdirs.size();
+                    {
+                        std::lock_guard<std::mutex> lock(queues[self].mutex);
+                        for (auto& sub : subdirs) queues[self].dirs.push_back(std::move(sub));
+                    }
+                    queued += subdirs.size();
+                    wake();
+                }
+                if (--pending == 0) wake();
+            }
+        });
+
+        std::vector<std::string> files;
+        size_t total = 0;
+        for (const auto& list : found) total += list.size();
+        files.reserve(total);
+        for (auto& list : found) {
+            std::move(list.begin(), list.end(), std::back_inserter(files));
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    // Whether a path relative to the repository root lies in .vcs
+    static bool isMetadataPath(const std::string& path) {
+        return path.compare(0, 4, ".vcs") == 0 && (path.size() == 4 || path[4] == '/');
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::string> dirs;  // relative to root
+    };
+
+    static bool takeWork(std::vector<WorkQueue>& queues, size_t self, std::string& dir) {
+        {
+            std::lock_guard<std::mutex> lock(queues[self].mutex);
+            if (!queues[self].dirs.empty()) {
+                dir = std::move(queues[self].dirs.back());
+                queues[self].dirs.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); ++k) {
+            WorkQueue& victim = queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.dirs.empty()) {
+                dir = std::move(victim.dirs.front());
+                victim.dirs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void scanDirectory(const std::string& root, const std::string& dir, const IgnoreRules* ignore,
+                              std::vector<std::string>& files, std::vector<std::string>& subdirs) {
+        std::string fullPath = dir.empty() ? root : root + "/" + dir;
+        DIR* handle = opendir(fullPath.c_str());
+        if (!handle) return;
+        std::string prefix = dir.empty() ? "" : dir + "/";
+        while (struct dirent* entry = readdir(handle)) {
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+            if (dir.empty() && std::strcmp(name, ".vcs") == 0) continue;
+            bool isDirectory = entry->d_type == DT_DIR;
+            bool isFile = entry->d_type == DT_REG;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat info;
+                if (stat((fullPath + "/" + name).c_str(), &info) != 0) continue;
+                isDirectory = entry->d_type == DT_UNKNOWN && S_ISDIR(info.st_mode);
+                isFile = S_ISREG(info.st_mode);
+            }
+            if (!isDirectory && !isFile) continue;
+            std::string path = prefix + name;
+            if (ignore && ignore->isIgnored(path, isDirectory)) continue;
+            (isDirectory ? subdirs : files).push_back(std::move(path));
+        }
+        closedir(handle);
+    }
+};
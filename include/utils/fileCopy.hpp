@@ -0,0 +1,159 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+// linux/fs.h defines these as macros, which would clash with class constants
+#undef BLOCK_SIZE
+#undef BLOCK_SIZE_BITS
+#endif
+
+// Copies file data with the cheapest mechanism the filesystem offers: a
+// reflink (FICLONE / FICLONERANGE) on copy-on-write filesystems such as btrfs
+// and xfs, then an in-kernel copy (copy_file_range, then sendfile), and a
+// buffered read/write loop only as a last resort. The object store uses it
+// for raw blobs, the only ones whose stored bytes are the file's own bytes.
+class FileCopy {
+public:
+    // Bytes moved by each mechanism, so callers can report what happened
+    struct Stats {
+        uint64_t bytesCloned = 0;    // shared with the source by a reflink
+        uint64_t bytesCopied = 0;    // copied inside the kernel
+        uint64_t bytesBuffered = 0;  // read into user space and written back
+
+        void add(const Stats& other) {
+            bytesCloned += other.bytesCloned;
+            bytesCopied += other.bytesCopied;
+            bytesBuffered += other.bytesBuffered;
+        }
+
+        bool empty() const {
+            return bytesCloned == 0 && bytesCopied == 0 && bytesBuffered == 0;
+        }
+
+        std::string summary() const {
+            return formatBytes(bytesCloned) + " cloned, " + formatBytes(bytesCopied + bytesBuffered) + " copied";
+        }
+    };
+
+    // Copy length bytes of source starting at sourceOffset into dest at
+    // destOffset. dest is created if needed and truncated to the end of the
+    // copied range. Reflinks need both offsets to be block aligned.
+    static bool copyRange(const std::string& source, uint64_t sourceOffset, uint64_t length,
+                          const std::string& dest, uint64_t destOffset, Stats& stats) {
+        int in = open(source.c_str(), O_RDONLY);
+        if (in < 0) return false;
+        int out = open(dest.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (out < 0) {
+            close(in);
+            return false;
+        }
+        bool ok = ftruncate(out, static_cast<off_t>(destOffset)) == 0 &&
+                  copyData(in, sourceOffset, out, destOffset, length, stats);
+        ok = close(out) == 0 && ok;
+        close(in);
+        return ok;
+    }
+
+    static std::string formatBytes(uint64_t bytes) {
+        const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+        double value = static_cast<double>(bytes);
+        int unit = 0;
+        while (value >= 1024 && unit < 4) {
+            value /= 1024;
+            ++unit;
+        }
+        char text[32];
+        std::snprintf(text, sizeof(text), unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+        return text;
+    }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    static bool copyData(int in, uint64_t inOffset, int out, uint64_t outOffset, uint64_t length, Stats& stats) {
+        if (length == 0) return true;
+#ifdef __linux__
+        if (tryClone(in, inOffset, out, outOffset, length)) {
+            stats.bytesCloned += length;
+            return true;
+        }
+        uint64_t done = 0;
+        // In-kernel copy; may fail outright on some filesystem combinations
+        loff_t inPos = static_cast<loff_t>(inOffset);
+        loff_t outPos = static_cast<loff_t>(outOffset);
+        while (done < length) {
+            ssize_t n = copy_file_range(in, &inPos, out, &outPos, length - done, 0);
+            if (n <= 0) break;
+            done += static_cast<uint64_t>(n);
+            stats.bytesCopied += static_cast<uint64_t>(n);
+        }
+        if (done < length && lseek(out, static_cast<off_t>(outOffset + done), SEEK_SET) >= 0) {
+            off_t sendPos = static_cast<off_t>(inOffset + done);
+            while (done < length) {
+                ssize_t n = sendfile(out, in, &sendPos, length - done);
+                if (n <= 0) break;
+                done += static_cast<uint64_t>(n);
+                stats.bytesCopied += static_cast<uint64_t>(n);
+            }
+        }
+        inOffset += done;
+        outOffset += done;
+        length -= done;
+#endif
+        return bufferedCopy(in, inOffset, out, outOffset, length, stats);
+    }
+
+#ifdef __linux__
+    static bool tryClone(int in, uint64_t inOffset, int out, uint64_t outOffset, uint64_t length) {
+        struct stat info;
+        if (fstat(in, &info) != 0) return false;
+        uint64_t size = static_cast<uint64_t>(info.st_size);
+        if (inOffset == 0 && outOffset == 0 && length == size) {
+            return ioctl(out, FICLONE, in) == 0;
+        }
+        // Ranges must start on a block boundary; a range that runs to the end
+        // of the source may have any length
+        uint64_t block = static_cast<uint64_t>(info.st_blksize > 0 ? info.st_blksize : 4096);
+        if (inOffset % block != 0 || outOffset % block != 0 || inOffset + length != size) return false;
+        struct file_clone_range range;
+        range.src_fd = in;
+        range.src_offset = inOffset;
+        range.src_length = length;
+        range.dest_offset = outOffset;
+        return ioctl(out, FICLONERANGE, &range) == 0;
+    }
+#endif
+
+    static bool bufferedCopy(int in, uint64_t inOffset, int out, uint64_t outOffset, uint64_t length,
+                             Stats& stats) {
+        std::vector<char> buffer(std::min<uint64_t>(BUFFER_SIZE, length));
+        while (length > 0) {
+            ssize_t n = pread(in, buffer.data(), std::min<uint64_t>(buffer.size(), length),
+                              static_cast<off_t>(inOffset));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            for (ssize_t written = 0; written < n;) {
+                ssize_t w = pwrite(out, buffer.data() + written, n - written,
+                                   static_cast<off_t>(outOffset + written));
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) return false;
+                written += w;
+            }
+            inOffset += n;
+            outOffset += n;
+            length -= n;
+            stats.bytesBuffered += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+};
@@ -1,26 +1,180 @@
 #pragma once
 #include <string>
 #include <sstream>
+#include <vector>
+#include <array>
+#include <functional>
+#include <optional>
+#include <memory>
+#include <stdexcept>
 #include <iomanip>
 #include <ctime>
-#define OPENSSL_SUPPRESS_DEPRECATED
-#include <openssl/sha.h>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
 #include <random>
+#include <fcntl.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+#include "threadPool.hpp"
+
+// A SHA-256 digest as its 32 raw bytes; hex is only for display and for the
+// names of objects on disk
+struct Digest {
+    static constexpr size_t SIZE = 32;
+    std::array<unsigned char, SIZE> bytes{};
+
+    const unsigned char* data() const { return bytes.data(); }
+    bool operator==(const Digest& other) const { return bytes == other.bytes; }
+    bool operator!=(const Digest& other) const { return bytes != other.bytes; }
+    bool operator<(const Digest& other) const { return bytes < other.bytes; }
+
+    std::string hex() const;
+    static Digest fromHex(const std::string& hex);
+};
+
+// Digests are uniformly distributed already, so their first bytes serve as
+// the hash for unordered containers
+namespace std {
+template <>
+struct hash<Digest> {
+    size_t operator()(const Digest& digest) const {
+        size_t h;
+        std::memcpy(&h, digest.data(), sizeof(h));
+        return h;
+    }
+};
+}
+
+// Incremental SHA-256 for data that arrives in pieces. Goes through OpenSSL's
+// EVP interface, which selects the fastest implementation for the CPU at run
+// time (SHA-NI on x86, the SHA extensions on ARMv8).
+class Sha256Stream {
+private:
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context{EVP_MD_CTX_new(), EVP_MD_CTX_free};
+
+public:
+    // The SHA-256 implementation, looked up once per process
+    static const EVP_MD* algorithm() {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        static EVP_MD* md = EVP_MD_fetch(nullptr, "SHA256", nullptr);
+        return md;
+#else
+        return EVP_sha256();
+#endif
+    }
+
+    Sha256Stream() {
+        if (!context || EVP_DigestInit_ex(context.get(), algorithm(), nullptr) != 1) {
+            throw std::runtime_error("Could not initialize SHA-256");
+        }
+    }
+
+    void update(const void* data, size_t length) {
+        EVP_DigestUpdate(context.get(), data, length);
+    }
+
+    Digest digest() {
+        Digest result;
+        unsigned int length = 0;
+        EVP_DigestFinal_ex(context.get(), result.bytes.data(), &length);
+        return result;
+    }
+
+    std::string hexDigest() { return digest().hex(); }
+};
 
 class HashUtils {
 public:
+    static constexpr size_t DIGEST_SIZE = Digest::SIZE;
+
+    static Digest computeDigest(const void* data, size_t length) {
+        Digest result;
+        unsigned int size = 0;
+        if (EVP_Digest(data, length, result.bytes.data(), &size, Sha256Stream::algorithm(), nullptr) != 1) {
+            throw std::runtime_error("Could not compute SHA-256");
+        }
+        return result;
+    }
+
     static std::string computeSHA256(const std::string& data) {
-        unsigned char hash[SHA256_DIGEST_LENGTH];
-        SHA256_CTX sha256;
-        SHA256_Init(&sha256);
-        SHA256_Update(&sha256, data.c_str(), data.length());
-        SHA256_Final(hash, &sha256);
+        return computeDigest(data.data(), data.size()).hex();
+    }
 
-        std::stringstream ss;
-        for(int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-            ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    // Hash a file in fixed-size chunks so memory use does not depend on its
+    // size. Returns nullopt if the file cannot be read.
+    static std::optional<Digest> computeFileDigest(const std::string& filePath) {
+        thread_local std::vector<char> buffer(1 << 20);
+        int fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) return std::nullopt;
+#ifdef POSIX_FADV_SEQUENTIAL
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        Sha256Stream sha;
+        ssize_t n;
+        while ((n = ::read(fd, buffer.data(), buffer.size())) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ::close(fd);
+                return std::nullopt;
+            }
+            sha.update(buffer.data(), static_cast<size_t>(n));
+        }
+        ::close(fd);
+        return sha.digest();
+    }
+
+    // Returns "" if the file cannot be read
+    static std::string computeFileSHA256(const std::string& filePath) {
+        auto digest = computeFileDigest(filePath);
+        return digest ? digest->hex() : "";
+    }
+
+    // Hash many files at once on a thread pool; result i belongs to paths[i]
+    static std::vector<std::optional<Digest>> computeFileDigests(const std::vector<std::string>& paths,
+                                                                ThreadPool& pool = ThreadPool::shared()) {
+        std::vector<std::optional<Digest>> digests(paths.size());
+        pool.parallelFor(paths.size(), [&](size_t i) { digests[i] = computeFileDigest(paths[i]); });
+        return digests;
+    }
+
+    // Convert a hex digest to its raw bytes (e.g. 64 hex chars -> 32 bytes)
+    static std::string hexToBinary(const std::string& hex) {
+        std::string bytes(hex.size() / 2, '\0');
+        hexToBinary(hex.data(), reinterpret_cast<unsigned char*>(bytes.data()), bytes.size());
+        return bytes;
+    }
+
+    static void hexToBinary(const char* hex, unsigned char* out, size_t length) {
+        const auto& values = hexValues();
+        for (size_t i = 0; i < length; ++i) {
+            out[i] = static_cast<unsigned char>((values[static_cast<unsigned char>(hex[2 * i])] << 4) |
+                                                values[static_cast<unsigned char>(hex[2 * i + 1])]);
         }
-        return ss.str();
+    }
+
+    // Convert raw digest bytes to lowercase hex, two characters per table lookup
+    static std::string binaryToHex(const unsigned char* bytes, size_t length) {
+        static const auto pairs = [] {
+            static const char digits[] = "0123456789abcdef";
+            std::array<char, 512> table{};
+            for (size_t i = 0; i < 256; ++i) {
+                table[2 * i] = digits[i >> 4];
+                table[2 * i + 1] = digits[i & 0x0f];
+            }
+            return table;
+        }();
+        std::string hex(length * 2, '0');
+        for (size_t i = 0; i < length; ++i) std::memcpy(&hex[2 * i], &pairs[2 * bytes[i]], 2);
+        return hex;
+    }
+
+    static bool isHexDigest(const std::string& s) {
+        if (s.size() != DIGEST_SIZE * 2) return false;
+        for (char c : s) {
+            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+        }
+        return true;
     }
 
     static std::string generateId(int length = 8) {
@@ -28,7 +182,7 @@ public:
             "0123456789"
             "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
             "abcdefghijklmnopqrstuvwxyz";
-        
+
         std::random_device rd;
         std::mt19937 gen(rd());
         std::uniform_int_distribution<> dis(0, sizeof(alphanum) - 2);
@@ -44,9 +198,32 @@ public:
     static std::string getCurrentTimestamp() {
         auto now = std::chrono::system_clock::now();
         auto in_time_t = std::chrono::system_clock::to_time_t(now);
-        
+
         std::stringstream ss;
         ss << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %H:%M:%S");
         return ss.str();
     }
-};
\ No newline at end of file
+
+private:
+    // Value of each hex digit by character; anything else reads as 0
+    static const std::array<unsigned char, 256>& hexValues() {
+        static const auto table = [] {
+            std::array<unsigned char, 256> values{};
+            for (int c = 0; c < 10; ++c) values['0' + c] = static_cast<unsigned char>(c);
+            for (int c = 0; c < 6; ++c) {
+                values['a' + c] = static_cast<unsigned char>(10 + c);
+                values['A' + c] = static_cast<unsigned char>(10 + c);
+            }
+            return values;
+        }();
+        return table;
+    }
+};
+
+inline std::string Digest::hex() const { return HashUtils::binaryToHex(bytes.data(), SIZE); }
+
+inline Digest Digest::fromHex(const std::string& hex) {
+    Digest digest;
+    if (hex.size() >= 2 * SIZE) HashUtils::hexToBinary(hex.data(), digest.bytes.data(), SIZE);
+    return digest;
+}
@@ -4,8 +4,11 @@
 #include <queue>
 #include <vector>
 #include <fstream>
-#include <sstream>
-#include <bitset>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include "binaryIO.hpp"
+#include "threadPool.hpp"
 
 class HuffmanNode {
 public:
@@ -20,66 +23,400 @@ public:
     }
 };
 
+// Order-0 Huffman coder.
+//
+// Current stream format (canonical Huffman, version 2):
+//   "HUF" 0x02 | size varint | code lengths | code bits, MSB-first
+// Only the code length of each byte value is stored (at most 15 bits), as
+// 128 bytes of packed nibbles (mode 0) or as (length << 4 | run - 1) bytes
+// (mode 1), whichever is shorter. Codes are assigned canonically from the
+// lengths, so encoder and decoder build the same code on every platform.
+//
+// Inputs larger than BLOCK_SIZE are cut into independent blocks, each with
+// its own length table, so they can be coded in parallel and a byte range
+// can be decoded without touching the rest (version 3):
+//   "HUF" 0x03 | size varint | blockSize varint | blockCount varint |
+//   compressed length varint x blockCount | blocks (length table + bits)
+//
+// Legacy streams ("<unique> <byte>:<freq> ... <pad> \n" + code bits) are
+// still decoded; their tree is rebuilt with the original priority_queue
+// construction in header order.
+//
+// Encoding writes codes straight into a 64-bit bit buffer; decoding resolves
+// up to TABLE_BITS bits (one or two symbols) per lookup and only walks the
+// tree for longer codes.
 class HuffmanCoder {
 public:
+    static constexpr unsigned MAX_CODE_LENGTH = 15;
+    static constexpr size_t BLOCK_SIZE = 1024 * 1024;
+
     // Compress file and return encoded string with header
     static std::string compress(const std::string& filePath) {
         std::ifstream file(filePath, std::ios::binary);
         std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        std::unordered_map<char, int> charFrequency;
-        for (char c : data) charFrequency[c]++;
-        std::priority_queue<HuffmanNode> pq;
-        for (const auto& [c, freq] : charFrequency) pq.push(HuffmanNode(c, freq));
-        while (pq.size() > 1) {
-            HuffmanNode* left = new HuffmanNode(pq.top()); pq.pop();
-            HuffmanNode* right = new HuffmanNode(pq.top()); pq.pop();
-            pq.push(HuffmanNode('\0', left->frequency + right->frequency, left, right));
+        return compressData(data);
+    }
+    // Compress in-memory buffer and return encoded string with header
+    static std::string compressData(const std::string& data) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+        if (data.size() <= BLOCK_SIZE) {
+            std::string result(CANONICAL_MAGIC, 4);
+            BinaryIO::putVarint(result, data.size());
+            if (!data.empty()) encodeBlock(bytes, data.size(), result);
+            return result;
+        }
+        size_t blockCount = (data.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        std::vector<std::string> blocks(blockCount);
+        ThreadPool::shared().parallelFor(blockCount, [&](size_t i) {
+            size_t offset = i * BLOCK_SIZE;
+            encodeBlock(bytes + offset, std::min(BLOCK_SIZE, data.size() - offset), blocks[i]);
+        });
+        std::string result(BLOCKED_MAGIC, 4);
+        BinaryIO::putVarint(result, data.size());
+        BinaryIO::putVarint(result, BLOCK_SIZE);
+        BinaryIO::putVarint(result, blockCount);
+        size_t bodySize = 0;
+        for (const auto& block : blocks) {
+            BinaryIO::putVarint(result, block.size());
+            bodySize += block.size();
+        }
+        result.reserve(result.size() + bodySize);
+        for (auto& block : blocks) {
+            result += block;
+            std::string().swap(block);
         }
-        HuffmanNode* root = nullptr;
-        if (!charFrequency.empty()) {
-            root = new HuffmanNode(pq.top()); pq.pop();
-        }
-        std::unordered_map<char, std::string> huffmanCodes;
-        if (root) encodeData(root, "", huffmanCodes);
-        // Header: number of unique chars, then (char, freq) pairs
-        std::ostringstream header;
-        header << (uint32_t)charFrequency.size() << " ";
-        for (const auto& [c, freq] : charFrequency) header << (int)(unsigned char)c << ":" << freq << " ";
-        // Encode data
-        std::string bitString;
-        for (char c : data) bitString += huffmanCodes[c];
-        // Pad to byte boundary
-        int pad = 8 - (bitString.size() % 8);
-        if (pad != 8) bitString.append(pad, '0');
-        header << pad << " ";
-        // Convert bitString to bytes
-        std::string compressedData;
-        for (size_t i = 0; i < bitString.size(); i += 8) {
-            std::bitset<8> byte(bitString.substr(i, 8));
-            compressedData += static_cast<char>(byte.to_ulong());
-        }
-        std::string result = header.str() + "\n" + compressedData;
-        deleteTree(root);
         return result;
     }
     // Decompress encoded string with header
     static std::string decompress(const std::string& compressedData) {
-        std::istringstream in(compressedData);
-        uint32_t unique;
-        in >> unique;
-        std::unordered_map<char, int> charFrequency;
+        if (compressedData.compare(0, 4, CANONICAL_MAGIC, 4) == 0) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(compressedData.data()) + 4;
+            const unsigned char* end = reinterpret_cast<const unsigned char*>(compressedData.data()) + compressedData.size();
+            uint64_t total = BinaryIO::getVarint(p, end);
+            std::string result(total, '\0');
+            if (total > 0) decodeBlock(p, end, &result[0], total);
+            return result;
+        }
+        if (compressedData.compare(0, 4, BLOCKED_MAGIC, 4) == 0) {
+            BlockIndex index = readBlockIndex(compressedData);
+            std::string result(index.totalSize, '\0');
+            ThreadPool::shared().parallelFor(index.offsets.size(), [&](size_t i) {
+                decodeIndexedBlock(compressedData, index, i, &result[i * index.blockSize]);
+            });
+            return result;
+        }
+        return decompressLegacy(compressedData);
+    }
+    // Decompress only bytes [offset, offset + length) of the original data.
+    // Blocked streams decode just the blocks that overlap the range.
+    static std::string decompressRange(const std::string& compressedData, uint64_t offset, uint64_t length) {
+        if (compressedData.compare(0, 4, BLOCKED_MAGIC, 4) != 0) {
+            std::string all = decompress(compressedData);
+            if (offset >= all.size()) return "";
+            return all.substr(offset, length);
+        }
+        BlockIndex index = readBlockIndex(compressedData);
+        if (offset >= index.totalSize) return "";
+        length = std::min(length, index.totalSize - offset);
+        if (length == 0) return "";
+        size_t first = offset / index.blockSize;
+        size_t last = (offset + length - 1) / index.blockSize;
+        std::string window((last - first + 1) * index.blockSize, '\0');
+        ThreadPool::shared().parallelFor(last - first + 1, [&](size_t k) {
+            decodeIndexedBlock(compressedData, index, first + k, &window[k * index.blockSize]);
+        });
+        return window.substr(offset - first * index.blockSize, length);
+    }
+private:
+    static constexpr unsigned TABLE_BITS = 11;
+
+    // Parse a decimal header field, skipping leading spaces
+    static uint64_t parseNumber(const char*& p, const char* end) {
+        while (p < end && *p == ' ') ++p;
+        if (p == end || *p < '0' || *p > '9') throw std::runtime_error("Corrupt Huffman header");
+        uint64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+        return value;
+    }
+
+    static constexpr const char* CANONICAL_MAGIC = "HUF\x02";
+
+    // Deterministic Huffman code lengths, limited to MAX_CODE_LENGTH.
+    // Leaves are taken in (frequency, byte) order and ties between a leaf and
+    // an internal node go to the leaf, so the result depends on the counts only.
+    static void buildCodeLengths(const uint64_t* counts, unsigned* lengths) {
+        std::vector<int> symbols;
+        for (int c = 0; c < 256; ++c) {
+            if (counts[c] > 0) symbols.push_back(c);
+        }
+        if (symbols.empty()) return;
+        if (symbols.size() == 1) {
+            lengths[symbols[0]] = 1;
+            return;
+        }
+        std::stable_sort(symbols.begin(), symbols.end(),
+                         [&](int a, int b) { return counts[a] < counts[b]; });
+
+        // Two-queue construction: leaves in sorted order, internal nodes in
+        // creation order (which is also non-decreasing in weight).
+        size_t n = symbols.size();
+        std::vector<uint64_t> weight(2 * n - 1);
+        std::vector<size_t> parent(2 * n - 1, 0);
+        for (size_t i = 0; i < n; ++i) weight[i] = counts[symbols[i]];
+        size_t nextLeaf = 0, nextInternal = n, created = n;
+        auto takeSmallest = [&]() {
+            if (nextLeaf < n && (nextInternal >= created || weight[nextLeaf] <= weight[nextInternal])) {
+                return nextLeaf++;
+            }
+            return nextInternal++;
+        };
+        while (created < 2 * n - 1) {
+            size_t a = takeSmallest();
+            size_t b = takeSmallest();
+            weight[created] = weight[a] + weight[b];
+            parent[a] = parent[b] = created;
+            ++created;
+        }
+        std::vector<unsigned> depth(2 * n - 1, 0);
+        unsigned blCount[64] = {0};
+        unsigned maxLength = 0;
+        for (size_t i = 2 * n - 2; i-- > 0;) {
+            depth[i] = depth[parent[i]] + 1;
+            if (i < n) {
+                blCount[depth[i]]++;
+                maxLength = std::max(maxLength, depth[i]);
+            }
+        }
+
+        // Move overlong codes up (JPEG Annex K.3): take two leaves from the
+        // deepest level, attach one of them next to a shallower leaf.
+        for (unsigned len = maxLength; len > MAX_CODE_LENGTH; --len) {
+            while (blCount[len] > 0) {
+                unsigned j = len - 2;
+                while (blCount[j] == 0) --j;
+                blCount[len] -= 2;
+                blCount[len - 1] += 1;
+                blCount[j + 1] += 2;
+                blCount[j] -= 1;
+            }
+        }
+
+        // Hand out the lengths again, shortest to the most frequent symbols
+        size_t next = n;
+        for (unsigned len = 1; len <= MAX_CODE_LENGTH; ++len) {
+            for (unsigned k = 0; k < blCount[len]; ++k) lengths[symbols[--next]] = len;
+        }
+    }
+
+    // Canonical codes: within each length, codes increase with the byte value
+    static void assignCanonicalCodes(const unsigned* lengths, uint64_t* codes) {
+        unsigned blCount[MAX_CODE_LENGTH + 1] = {0};
+        for (int c = 0; c < 256; ++c) {
+            if (lengths[c]) blCount[lengths[c]]++;
+        }
+        uint64_t nextCode[MAX_CODE_LENGTH + 2] = {0};
+        uint64_t code = 0;
+        for (unsigned len = 1; len <= MAX_CODE_LENGTH; ++len) {
+            code = (code + blCount[len - 1]) << 1;
+            nextCode[len] = code;
+        }
+        for (int c = 0; c < 256; ++c) {
+            if (lengths[c]) codes[c] = nextCode[lengths[c]]++;
+        }
+    }
+
+    static void writeCodeLengths(std::string& out, const unsigned* lengths) {
+        std::string rle;
+        for (int i = 0; i < 256;) {
+            int run = 1;
+            while (i + run < 256 && run < 16 && lengths[i + run] == lengths[i]) ++run;
+            rle += static_cast<char>((lengths[i] << 4) | (run - 1));
+            i += run;
+        }
+        if (rle.size() < 128) {
+            out += '\x01';
+            out += rle;
+            return;
+        }
+        out += '\x00';
+        for (int i = 0; i < 256; i += 2) {
+            out += static_cast<char>((lengths[i] << 4) | lengths[i + 1]);
+        }
+    }
+
+    static void readCodeLengths(const unsigned char*& p, const unsigned char* end, unsigned* lengths) {
+        if (p >= end) throw std::runtime_error("Corrupt Huffman header");
+        unsigned char mode = *p++;
+        if (mode == 0) {
+            if (end - p < 128) throw std::runtime_error("Corrupt Huffman header");
+            for (int i = 0; i < 256; i += 2, ++p) {
+                lengths[i] = *p >> 4;
+                lengths[i + 1] = *p & 0x0f;
+            }
+        } else if (mode == 1) {
+            int i = 0;
+            while (i < 256) {
+                if (p >= end) throw std::runtime_error("Corrupt Huffman header");
+                int run = (*p & 0x0f) + 1;
+                if (i + run > 256) throw std::runtime_error("Corrupt Huffman header");
+                for (int k = 0; k < run; ++k) lengths[i++] = *p >> 4;
+                ++p;
+            }
+        } else {
+            throw std::runtime_error("Unknown Huffman length table mode");
+        }
+    }
+
+    static constexpr const char* BLOCKED_MAGIC = "HUF\x03";
+
+    struct BlockIndex {
+        uint64_t totalSize = 0;
+        uint64_t blockSize = 0;
+        std::vector<uint64_t> offsets;  // start of each block in the stream
+        std::vector<uint64_t> sizes;    // compressed size of each block
+    };
+
+    static BlockIndex readBlockIndex(const std::string& compressedData) {
+        const unsigned char* begin = reinterpret_cast<const unsigned char*>(compressedData.data());
+        const unsigned char* p = begin + 4;
+        const unsigned char* end = begin + compressedData.size();
+        BlockIndex index;
+        index.totalSize = BinaryIO::getVarint(p, end);
+        index.blockSize = BinaryIO::getVarint(p, end);
+        uint64_t blockCount = BinaryIO::getVarint(p, end);
+        if (index.blockSize == 0 || blockCount != (index.totalSize + index.blockSize - 1) / index.blockSize ||
+            blockCount > compressedData.size()) {
+            throw std::runtime_error("Corrupt Huffman block index");
+        }
+        for (uint64_t i = 0; i < blockCount; ++i) index.sizes.push_back(BinaryIO::getVarint(p, end));
+        uint64_t offset = static_cast<uint64_t>(p - begin);
+        for (uint64_t size : index.sizes) {
+            index.offsets.push_back(offset);
+            offset += size;
+        }
+        if (offset > compressedData.size()) throw std::runtime_error("Corrupt Huffman block index");
+        return index;
+    }
+
+    static void decodeIndexedBlock(const std::string& compressedData, const BlockIndex& index,
+                                   size_t i, char* out) {
+        const unsigned char* begin = reinterpret_cast<const unsigned char*>(compressedData.data());
+        uint64_t rawSize = std::min<uint64_t>(index.blockSize, index.totalSize - i * index.blockSize);
+        decodeBlock(begin + index.offsets[i], begin + index.offsets[i] + index.sizes[i], out, rawSize);
+    }
+
+    // Append length table and code bits for one block of data (size > 0)
+    static void encodeBlock(const unsigned char* data, size_t size, std::string& result) {
+        uint64_t counts[256] = {0};
+        for (size_t i = 0; i < size; ++i) counts[data[i]]++;
+        unsigned lengths[256] = {0};
+        buildCodeLengths(counts, lengths);
+        uint64_t codes[256] = {0};
+        assignCanonicalCodes(lengths, codes);
+        writeCodeLengths(result, lengths);
+        uint64_t totalBits = 0;
+        for (int c = 0; c < 256; ++c) totalBits += counts[c] * lengths[c];
+
+        size_t headerSize = result.size();
+        result.resize(headerSize + (totalBits + 7) / 8);
+        unsigned char* out = reinterpret_cast<unsigned char*>(&result[headerSize]);
+        uint64_t acc = 0;
+        unsigned accBits = 0;
+        for (size_t i = 0; i < size; ++i) {
+            unsigned length = lengths[data[i]];
+            putBits(out, acc, accBits, codes[data[i]], length);
+        }
+        while (accBits >= 8) {
+            accBits -= 8;
+            *out++ = static_cast<unsigned char>(acc >> accBits);
+        }
+        if (accBits > 0) *out++ = static_cast<unsigned char>(acc << (8 - accBits));
+    }
+
+    // Decode `total` bytes of one block (length table + code bits) into out
+    static void decodeBlock(const unsigned char* p, const unsigned char* end, char* out, uint64_t total) {
+        unsigned lengths[256] = {0};
+        readCodeLengths(p, end, lengths);
+        uint64_t codes[256] = {0};
+        assignCanonicalCodes(lengths, codes);
+
+        // Rebuild the code tree; a valid table is a complete prefix code, or a
+        // single one-bit code
+        HuffmanNode* root = new HuffmanNode('\0', 0);
+        uint64_t kraft = 0;
+        unsigned used = 0;
+        bool valid = true;
+        for (int c = 0; c < 256 && valid; ++c) {
+            if (!lengths[c]) continue;
+            ++used;
+            kraft += uint64_t(1) << (MAX_CODE_LENGTH - lengths[c]);
+            HuffmanNode* node = root;
+            for (unsigned bit = lengths[c]; bit-- > 0;) {
+                if (node->frequency) { valid = false; break; }
+                HuffmanNode*& child = ((codes[c] >> bit) & 1) ? node->right : node->left;
+                if (!child) child = new HuffmanNode('\0', 0);
+                node = child;
+            }
+            if (!valid || node->left || node->right || node->frequency) { valid = false; break; }
+            node->character = static_cast<char>(c);
+            node->frequency = 1;  // marks a leaf
+        }
+        uint64_t full = uint64_t(1) << MAX_CODE_LENGTH;
+        valid = valid && (kraft == full || (used == 1 && kraft == full / 2));
+        size_t byteCount = static_cast<size_t>(end - p);
+        if (!valid || total > static_cast<uint64_t>(byteCount) * 8) {
+            deleteTree(root);
+            throw std::runtime_error("Corrupt Huffman stream");
+        }
+        try {
+            decodeSymbols(root, p, byteCount, out, total);
+        } catch (...) {
+            deleteTree(root);
+            throw;
+        }
+        deleteTree(root);
+    }
+
+    static std::string decompressLegacy(const std::string& compressedData) {
+        const char* p = compressedData.data();
+        const char* end = p + compressedData.size();
+        uint32_t unique = static_cast<uint32_t>(parseNumber(p, end));
+        // Keep the header order: it is the order the old encoder pushed symbols
+        // into the queue, and equal frequencies only yield the same tree that way.
+        std::vector<std::pair<char, int>> charFrequency;
+        uint64_t total = 0;
         for (uint32_t i = 0; i < unique; ++i) {
-            int c, freq;
-            char colon;
-            in >> c >> colon >> freq;
-            charFrequency[(char)c] = freq;
-        }
-        int pad;
-        in >> pad;
-        std::string dummy;
-        std::getline(in, dummy); // skip to data
-        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-        // Rebuild Huffman tree
+            int c = static_cast<int>(parseNumber(p, end));
+            if (p < end && *p == ':') ++p;
+            int freq = static_cast<int>(parseNumber(p, end));
+            charFrequency.emplace_back((char)c, freq);
+            total += static_cast<uint64_t>(freq);
+        }
+        parseNumber(p, end); // padding bits, implied by the symbol count
+        while (p < end && *p != '\n') ++p;
+        if (p < end) ++p; // skip to data
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(p);
+        size_t byteCount = static_cast<size_t>(end - p);
+
+        HuffmanNode* root = buildTree(charFrequency);
+        std::string result;
+        if (root && !root->left && !root->right) {
+            // Single distinct symbol: no bits were written, the count is in the header
+            result.assign(root->frequency, root->character);
+        } else if (root) {
+            if (total > static_cast<uint64_t>(byteCount) * 8) {
+                deleteTree(root);
+                throw std::runtime_error("Corrupt Huffman stream");
+            }
+            result.resize(total);
+            decodeSymbols(root, bytes, byteCount, &result[0], total);
+        }
+        deleteTree(root);
+        return result;
+    }
+
+    template <typename Frequencies>
+    static HuffmanNode* buildTree(const Frequencies& charFrequency) {
         std::priority_queue<HuffmanNode> pq;
         for (const auto& [c, freq] : charFrequency) pq.push(HuffmanNode(c, freq));
         while (pq.size() > 1) {
@@ -87,41 +424,143 @@ public:
             HuffmanNode* right = new HuffmanNode(pq.top()); pq.pop();
             pq.push(HuffmanNode('\0', left->frequency + right->frequency, left, right));
         }
-        HuffmanNode* root = nullptr;
-        if (!charFrequency.empty()) {
-            root = new HuffmanNode(pq.top()); pq.pop();
+        if (pq.empty()) return nullptr;
+        return new HuffmanNode(pq.top());
+    }
+    // Append the low `length` (<= MAX_CODE_LENGTH) bits of code to the bit buffer
+    static void putBits(unsigned char*& out, uint64_t& acc, unsigned& accBits, uint64_t code, unsigned length) {
+        acc = (acc << length) | code;
+        accBits += length;
+        if (accBits >= 32) {
+            accBits -= 32;
+            uint32_t word = static_cast<uint32_t>(acc >> accBits);
+            out[0] = static_cast<unsigned char>(word >> 24);
+            out[1] = static_cast<unsigned char>(word >> 16);
+            out[2] = static_cast<unsigned char>(word >> 8);
+            out[3] = static_cast<unsigned char>(word);
+            out += 4;
         }
-        // Convert bytes to bit string
-        std::string bitString;
-        for (unsigned char ch : bytes) {
-            std::bitset<8> bits(ch);
-            bitString += bits.to_string();
+    }
+    // Fill the lookup table: entries for codes of at most TABLE_BITS bits hold
+    // (length << 8 | symbol); longer codes get length 0 and the internal node
+    // reached after TABLE_BITS bits.
+    static void fillTable(const HuffmanNode* node, uint32_t code, unsigned length,
+                          uint16_t* table, const HuffmanNode** longNodes) {
+        if (!node) return;
+        if (!node->left && !node->right) {
+            uint32_t first = code << (TABLE_BITS - length);
+            uint32_t last = (code + 1) << (TABLE_BITS - length);
+            uint16_t entry = static_cast<uint16_t>((length << 8) | static_cast<unsigned char>(node->character));
+            for (uint32_t i = first; i < last; ++i) table[i] = entry;
+            return;
         }
-        if (pad != 8 && pad > 0) bitString.erase(bitString.end() - pad, bitString.end());
-        // Decode
-        std::string result;
-        if (root) {
-            HuffmanNode* node = root;
-            for (char bit : bitString) {
-                if (bit == '0') node = node->left;
-                else node = node->right;
-                if (!node->left && !node->right) {
-                    result += node->character;
-                    node = root;
-                }
-            }
+        if (length == TABLE_BITS) {
+            table[code] = 0;
+            longNodes[code] = node;
+            return;
         }
-        deleteTree(root);
-        return result;
+        fillTable(node->left, code << 1, length + 1, table, longNodes);
+        fillTable(node->right, (code << 1) | 1, length + 1, table, longNodes);
     }
-private:
-    static void encodeData(HuffmanNode* node, const std::string& code, std::unordered_map<char, std::string>& huffmanCodes) {
-        if (!node->left && !node->right) {
-            huffmanCodes[node->character] = code;
+    // Load bytes into the left-aligned bit buffer until at least 57 bits are valid.
+    // Bytes past the end of the stream read as zero.
+    static void refill(const unsigned char* bytes, size_t byteCount, size_t& pos,
+                       uint64_t& buf, unsigned& bitCount) {
+        if (pos + 8 <= byteCount) {
+            uint64_t word = 0;
+            for (int i = 0; i < 8; ++i) word = (word << 8) | bytes[pos + i];
+            buf |= word >> bitCount;
+            unsigned take = (63 - bitCount) >> 3;
+            pos += take;
+            bitCount += take * 8;
             return;
         }
-        encodeData(node->left, code + "0", huffmanCodes);
-        encodeData(node->right, code + "1", huffmanCodes);
+        while (bitCount <= 56) {
+            uint64_t byte = pos < byteCount ? bytes[pos] : 0;
+            ++pos;
+            buf |= byte << (56 - bitCount);
+            bitCount += 8;
+        }
+    }
+    static void decodeSymbols(const HuffmanNode* root, const unsigned char* bytes, size_t byteCount,
+                              char* out, uint64_t total) {
+        const size_t tableSize = size_t(1) << TABLE_BITS;
+        std::vector<uint16_t> single(tableSize, 0);
+        std::vector<const HuffmanNode*> longNodes(tableSize, nullptr);
+        fillTable(root, 0, 0, single.data(), longNodes.data());
+
+        // Second-level table decoding up to two symbols per lookup:
+        // sym1 | sym2 << 8 | count << 16 | len1 << 20 | totalLength << 24.
+        // An entry of 0 means the first code is longer than TABLE_BITS.
+        std::vector<uint32_t> pairs(tableSize, 0);
+        for (size_t i = 0; i < tableSize; ++i) {
+            uint32_t first = single[i];
+            uint32_t len1 = first >> 8;
+            if (len1 == 0) continue;
+            uint32_t entry = (first & 0xff) | (1u << 16) | (len1 << 20) | (len1 << 24);
+            uint32_t second = single[(i << len1) & (tableSize - 1)];
+            uint32_t len2 = second >> 8;
+            if (len2 != 0 && len1 + len2 <= TABLE_BITS) {
+                entry = (first & 0xff) | ((second & 0xff) << 8) | (2u << 16) | (len1 << 20) | ((len1 + len2) << 24);
+            }
+            pairs[i] = entry;
+        }
+        const uint32_t* pairTable = pairs.data();
+        const HuffmanNode* const* longTable = longNodes.data();
+
+        uint64_t buf = 0;
+        unsigned bitCount = 0;
+        size_t pos = 0;
+        char* const end = out + total;
+        auto decodeLong = [&](uint32_t index) {
+            const HuffmanNode* node = longTable[index];
+            if (!node) throw std::runtime_error("Corrupt Huffman stream");
+            buf <<= TABLE_BITS;
+            bitCount -= TABLE_BITS;
+            while (node->left) {
+                if (bitCount == 0) refill(bytes, byteCount, pos, buf, bitCount);
+                node = (buf >> 63) ? node->right : node->left;
+                buf <<= 1;
+                --bitCount;
+            }
+            *out++ = node->character;
+        };
+        // Fast path: a refill leaves >= 57 bits, so four lookups of at most
+        // TABLE_BITS bits each need no further checks.
+        while (end - out >= 8 && pos + 8 <= byteCount) {
+            uint64_t word = 0;
+            for (int i = 0; i < 8; ++i) word = (word << 8) | bytes[pos + i];
+            buf |= word >> bitCount;
+            pos += (63 - bitCount) >> 3;
+            bitCount |= 56;
+            for (int k = 0; k < 4; ++k) {
+                uint32_t index = static_cast<uint32_t>(buf >> (64 - TABLE_BITS));
+                uint32_t entry = pairTable[index];
+                if (entry == 0) {
+                    decodeLong(index);
+                    break;
+                }
+                out[0] = static_cast<char>(entry);
+                out[1] = static_cast<char>(entry >> 8);
+                out += (entry >> 16) & 0x3;
+                unsigned length = entry >> 24;
+                buf <<= length;
+                bitCount -= length;
+            }
+        }
+        while (out < end) {
+            refill(bytes, byteCount, pos, buf, bitCount);
+            uint32_t index = static_cast<uint32_t>(buf >> (64 - TABLE_BITS));
+            uint32_t entry = pairTable[index];
+            if (entry == 0) {
+                decodeLong(index);
+                continue;
+            }
+            *out++ = static_cast<char>(entry);
+            unsigned length = (entry >> 20) & 0xf;
+            buf <<= length;
+            bitCount -= length;
+        }
     }
     static void deleteTree(HuffmanNode* node) {
         if (!node) return;
@@ -129,4 +568,4 @@ private:
         deleteTree(node->right);
         delete node;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <fnmatch.h>
+
+// Patterns from a .vcsignore file, one per line, in a subset of gitignore
+// syntax:
+//   # comment        blank lines and comments are skipped
+//   build/           a trailing slash matches directories only
+//   *.o              a pattern without a slash matches the name at any depth
+//   /TODO, docs/*.md a pattern with a slash matches the path from the root
+//   !keep.o          a leading ! re-includes a file excluded by an earlier rule
+// The last matching rule wins. Files inside an ignored directory stay
+// ignored, since the walker never opens that directory.
+class IgnoreRules {
+private:
+    struct Rule {
+        std::string pattern;
+        bool negate = false;
+        bool directoryOnly = false;
+        bool anchored = false;  // match the whole relative path, not the name
+    };
+    std::vector<Rule> rules;
+
+public:
+    static IgnoreRules load(const std::string& path) {
+        IgnoreRules ignore;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            while (!line.empty() && (line.back() == ' ' || line.back() == '\t')) line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            Rule rule;
+            if (line[0] == '!') {
+                rule.negate = true;
+                line.erase(0, 1);
+            }
+            if (!line.empty() && line.back() == '/') {
+                rule.directoryOnly = true;
+                line.pop_back();
+            }
+            if (line.compare(0, 3, "**/") == 0) line.erase(0, 3);
+            if (!line.empty() && line[0] == '/') {
+                rule.anchored = true;
+                line.erase(0, 1);
+            }
+            if (line.find('/') != std::string::npos) rule.anchored = true;
+            if (line.empty()) continue;
+            rule.pattern = line;
+            ignore.rules.push_back(std::move(rule));
+        }
+        return ignore;
+    }
+
+    bool empty() const { return rules.empty(); }
+
+    // relativePath is relative to the repository root, '/'-separated
+    bool isIgnored(const std::string& relativePath, bool isDirectory) const {
+        size_t slash = relativePath.find_last_of('/');
+        const char* name = relativePath.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+        bool ignored = false;
+        for (const auto& rule : rules) {
+            if (rule.directoryOnly && !isDirectory) continue;
+            if (rule.negate != ignored) continue;  // cannot change the outcome
+            bool match = rule.anchored
+                ? fnmatch(rule.pattern.c_str(), relativePath.c_str(), FNM_PATHNAME) == 0
+                : fnmatch(rule.pattern.c_str(), name, 0) == 0;
+            if (match) ignored = !rule.negate;
+        }
+        return ignored;
+    }
+};
@@ -0,0 +1,224 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+// Line diff using Myers' O(ND) algorithm in linear space.
+//
+// Lines are found with memchr, which libc scans a vector register at a time,
+// and hashed a 64-bit word per step; the search compares only the hashes.
+// Lines it pairs up are then checked byte for byte, so a hash collision can
+// make a hunk larger but never wrong.
+class LineDiff {
+public:
+    // A line including its '\n'; the last line of a file may have none
+    using Line = std::string_view;
+
+    // Lines [aStart, aEnd) of a were replaced by lines [bStart, bEnd) of b
+    struct Hunk {
+        size_t aStart, aEnd;
+        size_t bStart, bEnd;
+    };
+
+    static std::vector<Line> splitLines(std::string_view text) {
+        std::vector<Line> lines;
+        const char* p = text.data();
+        const char* end = p + text.size();
+        while (p < end) {
+            const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            const char* next = newline ? newline + 1 : end;
+            lines.emplace_back(p, next - p);
+            p = next;
+        }
+        return lines;
+    }
+
+    // Text with a NUL byte near its start is treated as binary, as git does
+    static bool isBinary(std::string_view text) {
+        return std::memchr(text.data(), '\0', std::min<size_t>(text.size(), 8000)) != nullptr;
+    }
+
+    static uint64_t hashLine(Line line) {
+        constexpr uint64_t MULTIPLIER = 0xff51afd7ed558ccdULL;
+        const char* p = line.data();
+        size_t n = line.size();
+        uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+        for (; n >= 8; p += 8, n -= 8) {
+            uint64_t word;
+            std::memcpy(&word, p, 8);
+            h = (h ^ word) * MULTIPLIER;
+            h ^= h >> 32;
+        }
+        if (n > 0) {
+            uint64_t word = 0;
+            std::memcpy(&word, p, n);
+            h = (h ^ word) * MULTIPLIER;
+        }
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        return h ^ (h >> 33);
+    }
+
+    static std::vector<uint64_t> hashLines(const std::vector<Line>& lines) {
+        std::vector<uint64_t> hashes(lines.size());
+        for (size_t i = 0; i < lines.size(); ++i) hashes[i] = hashLine(lines[i]);
+        return hashes;
+    }
+
+    // The hunks that turn a into b, in order
+    static std::vector<Hunk> diff(const std::vector<Line>& a, const std::vector<Line>& b) {
+        Search search(hashLines(a), hashLines(b));
+        search.run();
+        auto paired = [&](size_t i, size_t j) {
+            return i < a.size() && j < b.size() && !search.changedA[i] && !search.changedB[j];
+        };
+        std::vector<Hunk> hunks;
+        size_t i = 0, j = 0;
+        while (i < a.size() || j < b.size()) {
+            if (paired(i, j) && a[i] == b[j]) {
+                ++i;
+                ++j;
+                continue;
+            }
+            size_t aStart = i, bStart = j;
+            do {
+                if (paired(i, j)) ++i, ++j;  // same hash, different line
+                while (i < a.size() && search.changedA[i]) ++i;
+                while (j < b.size() && search.changedB[j]) ++j;
+            } while (paired(i, j) && a[i] != b[j]);
+            if (i == aStart && j == bStart) break;
+            hunks.push_back({aStart, i, bStart, j});
+        }
+        return hunks;
+    }
+
+private:
+    // Past this many edits a split stops looking for the middle snake and
+    // takes the furthest point reached, trading minimality for time
+    static constexpr int64_t MIN_MAX_COST = 256;
+
+    class Search {
+    private:
+        const std::vector<uint64_t> a;
+        const std::vector<uint64_t> b;
+        std::vector<int64_t> forward;   // furthest x reached per diagonal, -1 if none
+        std::vector<int64_t> backward;  // the same, searching from the ends
+        int64_t diagonalOffset;
+
+        struct Range {
+            size_t aLo, aHi, bLo, bHi;
+        };
+
+        // One step of the search on every diagonal k of the same parity in
+        // [lo, hi]; equal(x, y) compares the elements at (x, y) in the
+        // direction searched
+        template <typename Equal>
+        static void step(int64_t* v, int64_t d, int64_t lo, int64_t hi, int64_t prevLo, int64_t prevHi,
+                         int64_t n, int64_t m, const Equal& equal) {
+            for (int64_t k = lo; k <= hi; k += 2) {
+                int64_t x = -1;
+                if (d == 0) {
+                    x = 0;
+                } else {
+                    if (k - 1 >= prevLo && k - 1 <= prevHi && v[k - 1] >= 0 && v[k - 1] < n) x = v[k - 1] + 1;
+                    if (k + 1 >= prevLo && k + 1 <= prevHi && v[k + 1] >= 0 && v[k + 1] - k <= m) {
+                        x = std::max(x, v[k + 1]);
+                    }
+                }
+                if (x >= 0) {
+                    int64_t y = x - k;
+                    while (x < n && y < m && equal(x, y)) {
+                        ++x;
+                        ++y;
+                    }
+                }
+                v[k] = x;
+            }
+        }
+
+        // A point on a shortest edit path through the range, other than its
+        // corners. The range must differ at both ends.
+        std::pair<size_t, size_t> split(const Range& r) {
+            const int64_t n = static_cast<int64_t>(r.aHi - r.aLo);
+            const int64_t m = static_cast<int64_t>(r.bHi - r.bLo);
+            const int64_t delta = n - m;
+            const bool odd = (delta & 1) != 0;
+            const int64_t maxCost = std::max<int64_t>(MIN_MAX_COST, static_cast<int64_t>(std::sqrt(double(n + m))));
+            int64_t* vf = forward.data() + diagonalOffset;
+            int64_t* vb = backward.data() + diagonalOffset;
+            auto forwardEqual = [&](int64_t x, int64_t y) { return a[r.aLo + x] == b[r.bLo + y]; };
+            auto backwardEqual = [&](int64_t x, int64_t y) { return a[r.aHi - 1 - x] == b[r.bHi - 1 - y]; };
+            int64_t prevLo = 0, prevHi = -1;
+            for (int64_t d = 0;; ++d) {
+                int64_t lo = -d, hi = d;
+                while (lo < -m) lo += 2;
+                while (hi > n) hi -= 2;
+                // Backward paths have made d - 1 steps here, over the
+                // diagonals forward paths covered at that step
+                step(vf, d, lo, hi, prevLo, prevHi, n, m, forwardEqual);
+                if (odd) {
+                    for (int64_t k = lo; k <= hi; k += 2) {
+                        int64_t kb = delta - k;
+                        if (vf[k] >= 0 && kb >= prevLo && kb <= prevHi && vb[kb] >= 0 && vf[k] + vb[kb] >= n) {
+                            return {r.aLo + vf[k], r.bLo + vf[k] - k};
+                        }
+                    }
+                }
+                step(vb, d, lo, hi, prevLo, prevHi, n, m, backwardEqual);
+                if (!odd) {
+                    for (int64_t k = lo; k <= hi; k += 2) {
+                        int64_t kf = delta - k;
+                        if (vb[k] >= 0 && kf >= lo && kf <= hi && vf[kf] >= 0 && vb[k] + vf[kf] >= n) {
+                            return {r.aHi - vb[k], r.bHi - (vb[k] - k)};
+                        }
+                    }
+                }
+                if (d >= maxCost) {
+                    int64_t bestK = lo;
+                    for (int64_t k = lo; k <= hi; k += 2) {
+                        if (vf[k] >= 0 && 2 * vf[k] - k > 2 * vf[bestK] - bestK) bestK = k;
+                    }
+                    if (vf[bestK] >= 0) return {r.aLo + vf[bestK], r.bLo + vf[bestK] - bestK};
+                }
+                prevLo = lo;
+                prevHi = hi;
+            }
+        }
+
+    public:
+        std::vector<char> changedA;
+        std::vector<char> changedB;
+
+        Search(std::vector<uint64_t> a, std::vector<uint64_t> b)
+            : a(std::move(a)), b(std::move(b)), forward(2 * (this->a.size() + this->b.size()) + 3),
+              backward(forward.size()), diagonalOffset(static_cast<int64_t>(this->b.size()) + 1),
+              changedA(this->a.size()), changedB(this->b.size()) {}
+
+        void run() {
+            std::vector<Range> pending{{0, a.size(), 0, b.size()}};
+            while (!pending.empty()) {
+                Range r = pending.back();
+                pending.pop_back();
+                while (r.aLo < r.aHi && r.bLo < r.bHi && a[r.aLo] == b[r.bLo]) ++r.aLo, ++r.bLo;
+                while (r.aLo < r.aHi && r.bLo < r.bHi && a[r.aHi - 1] == b[r.bHi - 1]) --r.aHi, --r.bHi;
+                if (r.aLo == r.aHi || r.bLo == r.bHi) {
+                    std::fill(changedA.begin() + r.aLo, changedA.begin() + r.aHi, 1);
+                    std::fill(changedB.begin() + r.bLo, changedB.begin() + r.bHi, 1);
+                    continue;
+                }
+                auto [x, y] = split(r);
+                if ((x == r.aLo && y == r.bLo) || (x == r.aHi && y == r.bHi)) {
+                    std::fill(changedA.begin() + r.aLo, changedA.begin() + r.aHi, 1);
+                    std::fill(changedB.begin() + r.bLo, changedB.begin() + r.bHi, 1);
+                    continue;
+                }
+                pending.push_back({x, r.aHi, y, r.bHi});
+                pending.push_back({r.aLo, x, r.bLo, y});
+            }
+        }
+    };
+};
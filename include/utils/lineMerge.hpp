@@ -0,0 +1,106 @@
+#pragma once
+#include "lineDiff.hpp"
+
+// Three-way merge of text by lines (diff3). Each side is diffed against the
+// base; a run of base lines that only one side changed takes that side's
+// lines, and runs changed by both (overlapping or touching hunks) become a
+// conflict unless both made the same change. Lines the two sides of a
+// conflict share at its start or end are kept outside the markers.
+class LineMerge {
+public:
+    struct Result {
+        std::string text;
+        size_t conflicts = 0;
+    };
+
+    static Result merge(const std::string& base, const std::string& ours, const std::string& theirs,
+                        const std::string& theirsLabel) {
+        auto baseLines = LineDiff::splitLines(base);
+        auto ourLines = LineDiff::splitLines(ours);
+        auto theirLines = LineDiff::splitLines(theirs);
+        auto ourHunks = LineDiff::diff(baseLines, ourLines);
+        auto theirHunks = LineDiff::diff(baseLines, theirLines);
+
+        Result result;
+        result.text.reserve(std::max(ours.size(), theirs.size()));
+        size_t i = 0, j = 0;       // next hunk on each side
+        size_t basePos = 0;        // base lines before this are written
+        int64_t ourShift = 0;      // line offset of each side against the base
+        int64_t theirShift = 0;
+        while (i < ourHunks.size() || j < theirHunks.size()) {
+            size_t i0 = i, j0 = j;
+            bool oursFirst = j == theirHunks.size() ||
+                             (i < ourHunks.size() && ourHunks[i].aStart <= theirHunks[j].aStart);
+            size_t lo = oursFirst ? ourHunks[i].aStart : theirHunks[j].aStart;
+            size_t hi = oursFirst ? ourHunks[i++].aEnd : theirHunks[j++].aEnd;
+            // Take in every hunk on either side that overlaps or touches the region
+            for (bool grew = true; grew;) {
+                grew = false;
+                for (; i < ourHunks.size() && ourHunks[i].aStart <= hi; ++i, grew = true) {
+                    hi = std::max(hi, ourHunks[i].aEnd);
+                }
+                for (; j < theirHunks.size() && theirHunks[j].aStart <= hi; ++j, grew = true) {
+                    hi = std::max(hi, theirHunks[j].aEnd);
+                }
+            }
+            append(result.text, baseLines, basePos, lo);
+            size_t ourStart = lo + ourShift, theirStart = lo + theirShift;
+            ourShift += shift(ourHunks, i0, i);
+            theirShift += shift(theirHunks, j0, j);
+            size_t ourEnd = hi + ourShift, theirEnd = hi + theirShift;
+            if (j == j0 || sameLines(ourLines, ourStart, ourEnd, theirLines, theirStart, theirEnd)) {
+                append(result.text, ourLines, ourStart, ourEnd);
+            } else if (i == i0) {
+                append(result.text, theirLines, theirStart, theirEnd);
+            } else {
+                while (ourStart < ourEnd && theirStart < theirEnd && ourLines[ourStart] == theirLines[theirStart]) {
+                    result.text += ourLines[ourStart++];
+                    ++theirStart;
+                }
+                size_t shared = 0;
+                while (ourEnd - shared > ourStart && theirEnd - shared > theirStart &&
+                       ourLines[ourEnd - shared - 1] == theirLines[theirEnd - shared - 1]) {
+                    ++shared;
+                }
+                result.text += "<<<<<<< HEAD\n";
+                appendSection(result.text, ourLines, ourStart, ourEnd - shared);
+                result.text += "=======\n";
+                appendSection(result.text, theirLines, theirStart, theirEnd - shared);
+                result.text += ">>>>>>> " + theirsLabel + "\n";
+                append(result.text, ourLines, ourEnd - shared, ourEnd);
+                ++result.conflicts;
+            }
+            basePos = hi;
+        }
+        append(result.text, baseLines, basePos, baseLines.size());
+        return result;
+    }
+
+private:
+    // Lines added minus lines removed by hunks [from, to)
+    static int64_t shift(const std::vector<LineDiff::Hunk>& hunks, size_t from, size_t to) {
+        int64_t lines = 0;
+        for (size_t k = from; k < to; ++k) {
+            lines += static_cast<int64_t>(hunks[k].bEnd - hunks[k].bStart) -
+                     static_cast<int64_t>(hunks[k].aEnd - hunks[k].aStart);
+        }
+        return lines;
+    }
+
+    static void append(std::string& out, const std::vector<LineDiff::Line>& lines, size_t start, size_t end) {
+        for (size_t k = start; k < end; ++k) out += lines[k];
+    }
+
+    // Lines inside conflict markers, ending in a newline so the next marker
+    // starts on its own line
+    static void appendSection(std::string& out, const std::vector<LineDiff::Line>& lines, size_t start, size_t end) {
+        append(out, lines, start, end);
+        if (start < end && out.back() != '\n') out += '\n';
+    }
+
+    static bool sameLines(const std::vector<LineDiff::Line>& a, size_t aStart, size_t aEnd,
+                          const std::vector<LineDiff::Line>& b, size_t bStart, size_t bEnd) {
+        return aEnd - aStart == bEnd - bStart &&
+               std::equal(a.begin() + aStart, a.begin() + aEnd, b.begin() + bStart);
+    }
+};
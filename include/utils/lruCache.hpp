@@ -0,0 +1,61 @@
+#pragma once
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
+
+// Least-recently-used cache bounded by a total cost (e.g. bytes or entries)
+template <typename Key, typename Value>
+class LruCache {
+private:
+    struct Item {
+        Key key;
+        Value value;
+        size_t cost;
+    };
+    std::list<Item> items;  // most recently used first
+    std::unordered_map<Key, typename std::list<Item>::iterator> lookup;
+    size_t capacity;
+    size_t used = 0;
+
+    void evict() {
+        while (used > capacity && !items.empty()) {
+            used -= items.back().cost;
+            lookup.erase(items.back().key);
+            items.pop_back();
+        }
+    }
+
+public:
+    explicit LruCache(size_t capacity) : capacity(capacity) {}
+
+    // Returns a pointer to the cached value, or nullptr on a miss
+    Value* get(const Key& key) {
+        auto it = lookup.find(key);
+        if (it == lookup.end()) return nullptr;
+        items.splice(items.begin(), items, it->second);
+        return &it->second->value;
+    }
+
+    void put(const Key& key, Value value, size_t cost = 1) {
+        if (cost > capacity) return;
+        auto it = lookup.find(key);
+        if (it != lookup.end()) {
+            used -= it->second->cost;
+            items.erase(it->second);
+            lookup.erase(it);
+        }
+        items.push_front({key, std::move(value), cost});
+        lookup[key] = items.begin();
+        used += cost;
+        evict();
+    }
+
+    void clear() {
+        items.clear();
+        lookup.clear();
+        used = 0;
+    }
+
+    size_t size() const { return items.size(); }
+};
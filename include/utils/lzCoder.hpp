@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include "binaryIO.hpp"
+
+// LZ77 match stage. Output is a byte stream meant to be entropy coded
+// afterwards:
+//
+//   rawSize varint | sequences...
+//   sequence: literalCount varint | literals | matchCode varint | [offset varint]
+//
+// matchCode is 0 for the final sequence (no match follows), otherwise the
+// match length minus MIN_MATCH plus one. Matches are found with a hash chain
+// over a sliding window of WINDOW_SIZE bytes.
+class LzCoder {
+public:
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t WINDOW_SIZE = 1 << 20;
+    static constexpr size_t MAX_CHAIN = 16;
+    static constexpr size_t GOOD_MATCH = 64;  // stop searching once a match is this long
+
+    static std::string encode(const std::string& input) {
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(input.data());
+        size_t size = input.size();
+        std::string out;
+        out.reserve(size / 2 + 16);
+        BinaryIO::putVarint(out, size);
+
+        std::vector<int64_t> head(HASH_SIZE, -1);
+        std::vector<int64_t> chain(std::min(size, WINDOW_SIZE), -1);
+        size_t literalStart = 0;
+        size_t pos = 0;
+        auto insert = [&](size_t at) {
+            uint32_t h = hash4(data + at);
+            chain[at % chain.size()] = head[h];
+            head[h] = static_cast<int64_t>(at);
+        };
+        while (pos + MIN_MATCH <= size) {
+            size_t bestLength = 0;
+            size_t bestOffset = 0;
+            int64_t candidate = head[hash4(data + pos)];
+            for (size_t depth = 0; candidate >= 0 && depth < MAX_CHAIN; ++depth) {
+                size_t offset = pos - static_cast<size_t>(candidate);
+                if (offset > WINDOW_SIZE || offset == 0) break;
+                const unsigned char* a = data + candidate;
+                const unsigned char* b = data + pos;
+                if (a[bestLength] == b[bestLength]) {
+                    size_t length = matchLength(a, b, size - pos);
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestOffset = offset;
+                        if (length >= GOOD_MATCH || length == size - pos) break;
+                    }
+                }
+                int64_t next = chain[static_cast<size_t>(candidate) % chain.size()];
+                if (next >= candidate) break;
+                candidate = next;
+            }
+            if (bestLength < MIN_MATCH) {
+                insert(pos);
+                ++pos;
+                continue;
+            }
+            BinaryIO::putVarint(out, pos - literalStart);
+            out.append(input, literalStart, pos - literalStart);
+            BinaryIO::putVarint(out, bestLength - MIN_MATCH + 1);
+            BinaryIO::putVarint(out, bestOffset);
+            size_t end = pos + bestLength;
+            for (; pos < end; ++pos) {
+                if (pos + MIN_MATCH <= size) insert(pos);
+            }
+            literalStart = pos;
+        }
+        BinaryIO::putVarint(out, size - literalStart);
+        out.append(input, literalStart, size - literalStart);
+        BinaryIO::putVarint(out, 0);
+        return out;
+    }
+
+    static std::string decode(const std::string& encoded) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(encoded.data());
+        const unsigned char* end = p + encoded.size();
+        uint64_t size = BinaryIO::getVarint(p, end);
+        std::string out(size, '\0');
+        char* dst = &out[0];
+        uint64_t written = 0;
+        for (;;) {
+            uint64_t literals = BinaryIO::getVarint(p, end);
+            if (literals > static_cast<uint64_t>(end - p) || literals > size - written) {
+                throw std::runtime_error("Corrupt LZ stream");
+            }
+            std::memcpy(dst + written, p, literals);
+            written += literals;
+            p += literals;
+            uint64_t matchCode = BinaryIO::getVarint(p, end);
+            if (matchCode == 0) break;
+            uint64_t length = matchCode - 1 + MIN_MATCH;
+            uint64_t offset = BinaryIO::getVarint(p, end);
+            if (offset == 0 || offset > written || length > size - written) {
+                throw std::runtime_error("Corrupt LZ stream");
+            }
+            char* from = dst + written - offset;
+            if (offset >= length) {
+                std::memcpy(dst + written, from, length);
+            } else {
+                // Overlapping match: repeats the last `offset` bytes
+                for (uint64_t i = 0; i < length; ++i) dst[written + i] = from[i];
+            }
+            written += length;
+        }
+        if (written != size) throw std::runtime_error("Corrupt LZ stream");
+        return out;
+    }
+
+private:
+    static constexpr size_t HASH_BITS = 16;
+    static constexpr size_t HASH_SIZE = size_t(1) << HASH_BITS;
+
+    // Length of the common prefix of a and b, compared 8 bytes at a time
+    static size_t matchLength(const unsigned char* a, const unsigned char* b, size_t limit) {
+        size_t length = 0;
+        while (length + 8 <= limit) {
+            uint64_t x, y;
+            std::memcpy(&x, a + length, 8);
+            std::memcpy(&y, b + length, 8);
+            if (x != y) break;
+            length += 8;
+        }
+        while (length < limit && a[length] == b[length]) ++length;
+        return length;
+    }
+
+    static uint32_t hash4(const unsigned char* p) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+};
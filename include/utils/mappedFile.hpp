@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    unsigned char* mapped = nullptr;
+    size_t length = 0;
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept : mapped(other.mapped), length(other.length) {
+        other.mapped = nullptr;
+        other.length = 0;
+    }
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            mapped = other.mapped;
+            length = other.length;
+            other.mapped = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        mapped = static_cast<unsigned char*>(p);
+        length = st.st_size;
+        return true;
+    }
+
+    void close() {
+        if (mapped) munmap(mapped, length);
+        mapped = nullptr;
+        length = 0;
+    }
+
+    bool isOpen() const { return mapped != nullptr; }
+    const unsigned char* data() const { return mapped; }
+    size_t size() const { return length; }
+};
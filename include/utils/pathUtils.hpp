@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <cstdint>
 #include <vector>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -16,6 +17,14 @@ public:
         return mkdir(path.c_str(), 0755) == 0;
     }
 
+    // Create directory and any missing parent directories
+    static bool createDirectories(const std::string& path) {
+        if (path.empty() || isDirectory(path)) return true;
+        std::string parent = getDirectory(path);
+        if (!parent.empty() && !createDirectories(parent)) return false;
+        return createDirectory(path) || isDirectory(path);
+    }
+
     // Check if path exists
     static bool exists(const std::string& path) {
         struct stat buffer;
@@ -45,50 +54,6 @@ public:
         throw std::runtime_error("Could not get current working directory");
     }
 
-    // Copy a single file
-    static bool copyFile(const std::string& source, const std::string& dest) {
-        std::ifstream src(source, std::ios::binary);
-        if (!src) return false;
-
-        std::ofstream dst(dest, std::ios::binary);
-        if (!dst) return false;
-
-        dst << src.rdbuf();
-        return true;
-    }
-
-    // Copy directory recursively
-    static bool copyDirectory(const std::string& source, const std::string& dest) {
-        DIR* dir = opendir(source.c_str());
-        if (!dir) return false;
-
-        createDirectory(dest);
-        struct dirent* entry;
-
-        while ((entry = readdir(dir)) != nullptr) {
-            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) 
-                continue;
-
-            std::string srcPath = source + "/" + entry->d_name;
-            std::string dstPath = dest + "/" + entry->d_name;
-
-            if (isDirectory(srcPath)) {
-                if (!copyDirectory(srcPath, dstPath)) {
-                    closedir(dir);
-                    return false;
-                }
-            } else {
-                if (!copyFile(srcPath, dstPath)) {
-                    closedir(dir);
-                    return false;
-                }
-            }
-        }
-
-        closedir(dir);
-        return true;
-    }
-
     // Remove a single file
     static bool removeFile(const std::string& path) {
         return unlink(path.c_str()) == 0;
@@ -117,25 +82,25 @@ public:
         return rmdir(path.c_str()) == 0;
     }
 
-    // List files in directory (non-recursive)
-    static std::vector<std::string> listDirectory(const std::string& path) {
-        std::vector<std::string> files;
-        DIR* dir = opendir(path.c_str());
-        if (!dir) return files;
-
-        struct dirent* entry;
-        while ((entry = readdir(dir)) != nullptr) {
-            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) 
-                continue;
-            files.push_back(entry->d_name);
+    // Total size of the files under a directory
+    static uint64_t getDirectorySize(const std::string& path) {
+        uint64_t total = 0;
+        for (const auto& name : listDirectory(path)) {
+            std::string fullPath = path + "/" + name;
+            total += isDirectory(fullPath) ? getDirectorySize(fullPath) : getFileSize(fullPath);
         }
+        return total;
+    }
 
-        closedir(dir);
-        return files;
+    // Remove the directories above a deleted file for as long as they are empty
+    static void removeEmptyParents(const std::string& path) {
+        for (std::string dir = getDirectory(path); !dir.empty(); dir = getDirectory(dir)) {
+            if (rmdir(dir.c_str()) != 0) break;
+        }
     }
 
-    // List files in directory recursively
-    static std::vector<std::string> listRecursiveDirectory(const std::string& path) {
+    // List files in directory (non-recursive)
+    static std::vector<std::string> listDirectory(const std::string& path) {
         std::vector<std::string> files;
         DIR* dir = opendir(path.c_str());
         if (!dir) return files;
@@ -144,16 +109,7 @@ public:
         while ((entry = readdir(dir)) != nullptr) {
             if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) 
                 continue;
-
-            std::string fullPath = path + "/" + entry->d_name;
-            if (isDirectory(fullPath)) {
-                auto subFiles = listRecursiveDirectory(fullPath);
-                for (const auto& file : subFiles) {
-                    files.push_back(entry->d_name + std::string("/") + file);
-                }
-            } else {
-                files.push_back(entry->d_name);
-            }
+            files.push_back(entry->d_name);
         }
 
         closedir(dir);
@@ -187,6 +143,26 @@ public:
         return buffer.st_size;
     }
 
+    // Stat data used to tell whether a file changed without reading it
+    struct FileStat {
+        uint64_t size = 0;
+        uint64_t mtimeNs = 0;
+        uint64_t inode = 0;
+        uint32_t mode = 0;  // permission bits
+    };
+
+    // stat() a regular file; returns false if it is missing or not a file
+    static bool statFile(const std::string& path, FileStat& info) {
+        struct stat buffer;
+        if (stat(path.c_str(), &buffer) != 0 || !S_ISREG(buffer.st_mode)) return false;
+        info.size = static_cast<uint64_t>(buffer.st_size);
+        info.mtimeNs = static_cast<uint64_t>(buffer.st_mtim.tv_sec) * 1000000000ull +
+                       static_cast<uint64_t>(buffer.st_mtim.tv_nsec);
+        info.inode = static_cast<uint64_t>(buffer.st_ino);
+        info.mode = static_cast<uint32_t>(buffer.st_mode & 07777);
+        return true;
+    }
+
     // Get last modified time
     static time_t getLastModifiedTime(const std::string& path) {
         struct stat buffer;
@@ -0,0 +1,116 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <queue>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+// Fixed-size pool of worker threads with a FIFO task queue
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t threadCount) {
+        for (size_t i = 0; i < std::max<size_t>(1, threadCount); ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push(std::move(task));
+        }
+        available.notify_one();
+    }
+
+    // Process-wide pool sized to the number of hardware threads
+    static ThreadPool& shared() {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+
+    // Run fn(i) for every i in [0, count) and wait for all of them. The calling
+    // thread takes indices too, so this is safe to call from inside a pool task
+    // and never waits on work that is still queued. The first exception thrown
+    // by fn is rethrown here.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+        if (count == 0) return;
+        if (count == 1 || size() == 1) {
+            for (size_t i = 0; i < count; ++i) fn(i);
+            return;
+        }
+        struct State {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> finished{0};
+            size_t count;
+            const std::function<void(size_t)>* fn;
+            std::mutex mutex;
+            std::condition_variable done;
+            std::exception_ptr error;
+        };
+        auto state = std::make_shared<State>();
+        state->count = count;
+        state->fn = &fn;
+        auto run = [](const std::shared_ptr<State>& s) {
+            for (size_t i; (i = s->next.fetch_add(1)) < s->count;) {
+                try {
+                    (*s->fn)(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(s->mutex);
+                    if (!s->error) s->error = std::current_exception();
+                }
+                if (s->finished.fetch_add(1) + 1 == s->count) {
+                    std::lock_guard<std::mutex> lock(s->mutex);
+                    s->done.notify_all();
+                }
+            }
+        };
+        size_t helpers = std::min(count - 1, size());
+        for (size_t h = 0; h < helpers; ++h) {
+            submit([state, run] { run(state); });
+        }
+        run(state);
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&] { return state->finished.load() == state->count; });
+        if (state->error) std::rethrow_exception(state->error);
+    }
+};
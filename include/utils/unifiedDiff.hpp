@@ -0,0 +1,50 @@
+#pragma once
+#include "lineDiff.hpp"
+#include "../common.hpp"
+#include <ostream>
+
+// Writes the hunks of a line diff in unified format, with CONTEXT unchanged
+// lines around each change. Hunks whose context would overlap are joined.
+class UnifiedDiff {
+public:
+    static constexpr size_t CONTEXT = 3;
+
+    static void write(std::ostream& out, const std::vector<LineDiff::Line>& a, const std::vector<LineDiff::Line>& b,
+                      const std::vector<LineDiff::Hunk>& hunks, bool color) {
+        for (size_t first = 0; first < hunks.size();) {
+            size_t last = first;
+            while (last + 1 < hunks.size() && hunks[last + 1].aStart - hunks[last].aEnd <= 2 * CONTEXT) ++last;
+            size_t aFrom = hunks[first].aStart - std::min(hunks[first].aStart, CONTEXT);
+            size_t aTo = std::min(a.size(), hunks[last].aEnd + CONTEXT);
+            size_t bFrom = hunks[first].bStart - (hunks[first].aStart - aFrom);
+            size_t bTo = hunks[last].bEnd + (aTo - hunks[last].aEnd);
+            out << (color ? CYN : "") << "@@ -" << range(aFrom, aTo) << " +" << range(bFrom, bTo) << " @@"
+                << (color ? END : "") << "\n";
+            size_t pos = aFrom;
+            for (size_t h = first; h <= last; ++h) {
+                for (; pos < hunks[h].aStart; ++pos) writeLine(out, ' ', a[pos], "");
+                for (size_t i = hunks[h].aStart; i < hunks[h].aEnd; ++i) writeLine(out, '-', a[i], color ? RED : "");
+                for (size_t j = hunks[h].bStart; j < hunks[h].bEnd; ++j) writeLine(out, '+', b[j], color ? GRN : "");
+                pos = hunks[h].aEnd;
+            }
+            for (; pos < aTo; ++pos) writeLine(out, ' ', a[pos], "");
+            first = last + 1;
+        }
+    }
+
+private:
+    // "start,length" with 1-based lines; an empty range names the line before it
+    static std::string range(size_t from, size_t to) {
+        size_t length = to - from;
+        std::string text = std::to_string(length == 0 ? from : from + 1);
+        if (length != 1) text += "," + std::to_string(length);
+        return text;
+    }
+
+    static void writeLine(std::ostream& out, char prefix, LineDiff::Line line, const char* color) {
+        bool newline = !line.empty() && line.back() == '\n';
+        if (newline) line.remove_suffix(1);
+        out << color << prefix << line << (*color ? END : "") << "\n";
+        if (!newline) out << "\\ No newline at end of file\n";
+    }
+};
@@ -1,64 +1,125 @@
 #include "branchManager.hpp"
-#include <nlohmann/json.hpp>
+#include "common.hpp"
+#include "pathUtils.hpp"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 
-using json = nlohmann::json;
+namespace {
+
+const std::string HEAD_PATH = PathUtils::joinPath(".vcs", "HEAD");
+const std::string REFS_PATH = PathUtils::joinPath(".vcs", "refs", "heads");
+const std::string HEAD_PREFIX = "ref: refs/heads/";
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+std::string firstLine(const std::string& contents) {
+    return contents.substr(0, contents.find('\n'));
+}
+
+}
 
 BranchManager::BranchManager() {
     loadBranchState();
 }
 
-BranchManager::~BranchManager() {
-    saveBranchState();
+bool BranchManager::isValidName(const std::string& name) {
+    if (name.empty() || name.front() == '/' || name.back() == '/' || name.front() == '-') return false;
+    if (name.find("..") != std::string::npos || name.find("//") != std::string::npos) return false;
+    if (name.front() == '.' || name.find("/.") != std::string::npos) return false;
+    if (name.size() >= 5 && name.compare(name.size() - 5, 5, ".lock") == 0) return false;
+    for (unsigned char c : name) {
+        if (c < 0x20 || c == 0x7f || std::strchr(" ~^:?*[\\", c)) return false;
+    }
+    return true;
 }
 
 void BranchManager::loadBranchState() {
-    try {
-        std::ifstream file(".vcs/branches.json");
-        if (file.is_open()) {
-            json j = json::parse(file);
-            currentBranch = j["currentBranch"];
-            
-            for (const auto& [name, branchData] : j["branches"].items()) {
-                auto branch = std::make_shared<Branch>(name, branchData["currentCommitId"]);
-                branch->commitHistory = branchData["commitHistory"].get<std::vector<std::string>>();
-                branches[name] = branch;
-            }
+    if (!PathUtils::isDirectory(".vcs")) return;
+    std::string jsonPath = PathUtils::joinPath(".vcs", "branches.json");
+    if (PathUtils::exists(jsonPath)) {
+        loadBranchesJson(jsonPath);
+        return;
+    }
+    loadRefs(REFS_PATH, "");
+    std::string head = firstLine(readFile(HEAD_PATH));
+    if (head.compare(0, HEAD_PREFIX.size(), HEAD_PREFIX) == 0) {
+        currentBranch = head.substr(HEAD_PREFIX.size());
+    }
+}
+
+void BranchManager::loadRefs(const std::string& dir, const std::string& prefix) {
+    for (const auto& entry : PathUtils::listDirectory(dir)) {
+        std::string path = PathUtils::joinPath(dir, entry);
+        std::string name = prefix + entry;
+        if (PathUtils::isDirectory(path)) {
+            loadRefs(path, name + "/");
+        } else if (isValidName(name)) {
+            refContents[name] = readFile(path);
+            branches[name] = std::make_shared<Branch>(name, firstLine(refContents[name]));
         }
-    } catch (...) {
-        // Initialize with default state if file doesn't exist
-        createBranch("main");
     }
 }
 
-void BranchManager::saveBranchState() const {
+// Branches used to be kept in .vcs/branches.json along with every commit
+// made on them, rewritten in full on each change. Keep only the tips; the
+// next flush writes them as refs and deletes the file.
+void BranchManager::loadBranchesJson(const std::string& jsonPath) {
     json j;
-    j["currentBranch"] = currentBranch;
-    
-    json branchesJson;
-    for (const auto& [name, branch] : branches) {
-        branchesJson[name] = {
-            {"name", branch->name},
-            {"currentCommitId", branch->currentCommitId},
-            {"commitHistory", branch->commitHistory}
-        };
+    try {
+        std::ifstream file(jsonPath);
+        j = json::parse(file);
+    } catch (const json::exception& e) {
+        throw std::runtime_error("Could not parse " + jsonPath + ": " + e.what());
     }
-    j["branches"] = branchesJson;
+    for (const auto& [name, branchData] : j["branches"].items()) {
+        if (!isValidName(name)) {
+            std::cerr << YEL "Warning: dropping branch with unsupported name '" << name << "'" END << std::endl;
+            continue;
+        }
+        branches[name] = std::make_shared<Branch>(name, branchData.value("currentCommitId", ""));
+        dirtyRefs.insert(name);
+    }
+    currentBranch = j.value("currentBranch", "main");
+    headDirty = true;
+    legacyJsonPath = jsonPath;
+}
 
-    std::ofstream file(".vcs/branches.json");
-    file << j.dump(4);
+void BranchManager::flush(RepoTransaction& tx) {
+    for (const auto& name : dirtyRefs) {
+        std::string contents = branches[name]->currentCommitId + "\n";
+        std::optional<std::string> expected;
+        if (legacyJsonPath.empty()) {
+            auto it = refContents.find(name);
+            expected = it != refContents.end() ? it->second : "";
+        }
+        tx.replace(PathUtils::joinPath(REFS_PATH, name), contents, expected);
+        refContents[name] = contents;
+    }
+    dirtyRefs.clear();
+    if (headDirty) tx.replace(HEAD_PATH, HEAD_PREFIX + currentBranch + "\n");
+    headDirty = false;
+    if (!legacyJsonPath.empty()) tx.remove(legacyJsonPath);
+    legacyJsonPath.clear();
 }
 
 bool BranchManager::createBranch(const std::string& name, const std::string& startCommit) {
+    if (!isValidName(name)) {
+        throw std::runtime_error("Invalid branch name: " + name);
+    }
     if (branches.find(name) != branches.end()) {
         return false;
     }
 
     branches[name] = std::make_shared<Branch>(name, startCommit);
+    dirtyRefs.insert(name);
     if (branches.size() == 1) {
         currentBranch = name;
+        headDirty = true;
     }
-    saveBranchState();
     return true;
 }
 
@@ -67,17 +128,16 @@ bool BranchManager::switchBranch(const std::string& name) {
         return false;
     }
     
+    if (name != currentBranch) headDirty = true;
     currentBranch = name;
-    saveBranchState();
     return true;
 }
 
 void BranchManager::updateBranchCommit(const std::string& commitId) {
-    if (auto branch = branches[currentBranch]) {
-        branch->currentCommitId = commitId;
-        branch->commitHistory.push_back(commitId);
-        saveBranchState();
-    }
+    auto it = branches.find(currentBranch);
+    if (it == branches.end()) return;
+    it->second->currentCommitId = commitId;
+    dirtyRefs.insert(currentBranch);
 }
 
 std::string BranchManager::getCurrentBranch() const {
@@ -94,6 +154,7 @@ std::vector<std::string> BranchManager::getAllBranches() const {
     for (const auto& [name, _] : branches) {
         names.push_back(name);
     }
+    std::sort(names.begin(), names.end());
     return names;
 }
 
@@ -104,4 +165,4 @@ bool BranchManager::branchExists(const std::string& name) const {
 std::string BranchManager::getBranchCommit(const std::string& branchName) const {
     auto it = branches.find(branchName);
     return it != branches.end() ? it->second->currentCommitId : "";
-}
\ No newline at end of file
+}
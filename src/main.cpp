@@ -7,14 +7,28 @@ void printUsage() {
     std::cout << YEL "VCS (Version Control System) - A lightweight version control system\n\n"
               << "Usage:\n"
               << "  vcs init                           - Initialize repository\n"
-              << "  vcs add <'.'|'file_name'>         - Add files to staging area\n"
+              << "  vcs add [-j N] <'.'|'file_name'>  - Stage files, storing them with N workers\n"
               << "  vcs commit -m 'message'           - Commit staged files\n"
               << "  vcs status                        - Show working tree status\n"
               << "  vcs branch [name]                 - List/create branches\n"
-              << "  vcs checkout <branch>             - Switch branches\n"
+              << "  vcs checkout [-f] <branch>        - Switch branches (-f discards local changes)\n"
               << "  vcs merge <branch>                - Merge branch into current\n"
               << "  vcs revert <'HEAD'|commit>        - Revert to commit\n"
-              << "  vcs log                          - Show commit history\n" END << std::endl;
+              << "  vcs log                          - Show commit history\n"
+              << "  vcs diff [--stat|--name-only] [commit [commit]] [-- paths]\n"
+              << "                                    - Show changes (default: staged files vs working tree)\n"
+              << "  vcs repack                        - Pack loose objects\n"
+              << "  vcs gc [--now]                    - Delete unreachable objects and repack the rest\n"
+              << "                                    (--now skips the grace period)\n"
+              << "  vcs migrate                       - Convert data left by earlier versions\n" END << std::endl;
+}
+
+size_t parseJobs(const std::string& value) {
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos ||
+        value.size() > 4 || std::stoul(value) == 0) {
+        throw std::runtime_error("Invalid job count: " + value);
+    }
+    return std::stoul(value);
 }
 
 int main(int argc, char* argv[]) {
@@ -23,24 +37,30 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    VCS vcs;
     std::string command = argv[1];
 
     try {
+        VCS vcs;
         if (command == "init") {
             vcs.init();
         }
         else if (command == "add") {
-            if (argc == 2) {
-                throw std::runtime_error("Missing file argument\nUsage: vcs add <'.'|'file_name'>");
-            }
-            if (argc == 3 && std::string(argv[2]) == ".") {
-                vcs.add();
-            } else {
-                for (int i = 2; i < argc; ++i) {
-                    vcs.add(argv[i]);
+            std::vector<std::string> paths;
+            size_t jobs = 0;
+            for (int i = 2; i < argc; ++i) {
+                std::string arg = argv[i];
+                if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+                    jobs = parseJobs(argv[++i]);
+                } else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2) {
+                    jobs = parseJobs(arg.substr(2));
+                } else {
+                    paths.push_back(arg);
                 }
             }
+            if (paths.empty()) {
+                throw std::runtime_error("Missing file argument\nUsage: vcs add [-j N] <'.'|'file_name'>");
+            }
+            vcs.add(paths, jobs);
         }
         else if (command == "commit") {
             if (argc != 4 || std::string(argv[2]) != "-m") {
@@ -59,10 +79,12 @@ int main(int argc, char* argv[]) {
             }
         }
         else if (command == "checkout") {
-            if (argc < 3) {
-                throw std::runtime_error("Branch name required\nUsage: vcs checkout <branch>");
+            bool force = argc > 2 && (std::string(argv[2]) == "-f" || std::string(argv[2]) == "--force");
+            int branchArg = force ? 3 : 2;
+            if (argc <= branchArg) {
+                throw std::runtime_error("Branch name required\nUsage: vcs checkout [-f] <branch>");
             }
-            vcs.checkout(argv[2]);
+            vcs.checkout(argv[branchArg], force);
         }
         else if (command == "merge") {
             if (argc < 3) {
@@ -76,9 +98,51 @@ int main(int argc, char* argv[]) {
             }
             vcs.revert(argv[2]);
         }
+        else if (command == "diff") {
+            VCS::DiffFormat format = VCS::DiffFormat::Patch;
+            std::vector<std::string> commits;
+            std::vector<std::string> paths;
+            bool pathArgs = false;
+            for (int i = 2; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (pathArgs) {
+                    paths.push_back(arg);
+                } else if (arg == "--") {
+                    pathArgs = true;
+                } else if (arg == "--stat") {
+                    format = VCS::DiffFormat::Stat;
+                } else if (arg == "--name-only") {
+                    format = VCS::DiffFormat::NameOnly;
+                } else if (!arg.empty() && arg[0] == '-') {
+                    throw std::runtime_error("Unknown option: " + arg);
+                } else {
+                    commits.push_back(arg);
+                }
+            }
+            if (commits.size() > 2) {
+                throw std::runtime_error("Too many commits\nUsage: vcs diff [--stat|--name-only] [commit [commit]] [-- paths]");
+            }
+            vcs.diff(commits, paths, format);
+        }
         else if (command == "log") {
             vcs.log();
         }
+        else if (command == "repack") {
+            vcs.repack();
+        }
+        else if (command == "gc") {
+            bool now = false;
+            for (int i = 2; i < argc; ++i) {
+                if (std::string(argv[i]) != "--now") {
+                    throw std::runtime_error("Unknown option: " + std::string(argv[i]) + "\nUsage: vcs gc [--now]");
+                }
+                now = true;
+            }
+            vcs.gc(now);
+        }
+        else if (command == "migrate") {
+            vcs.migrate();
+        }
         else {
             std::cout << RED "Unknown command: " << command << END << std::endl;
             printUsage();
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Grow one repository commit by commit and time commands that need little
+# or none of the history. Their cost should stay flat as history grows.
+#
+# Usage: bench_startup.sh [commit counts...]   (default: 100 1000 5000)
+
+BENCH_DIR="vcs_startup_bench_repo"
+LOG_FILE="vcs_startup_bench_log.txt"
+VCS_BIN="../build/vcs"
+RUNS=20
+SIZES=("$@")
+[ ${#SIZES[@]} -eq 0 ] && SIZES=(100 1000 5000)
+
+rm -rf "$BENCH_DIR"
+rm -f "$LOG_FILE"
+
+# Average wall time of a command over RUNS runs, in milliseconds
+average_ms() {
+    local start end
+    start=$(date +%s%N)
+    for _ in $(seq $RUNS); do
+        "$@" > /dev/null 2>&1
+    done
+    end=$(date +%s%N)
+    awk -v ns=$((end - start)) -v runs=$RUNS 'BEGIN { printf "%.2f", ns / runs / 1000000 }'
+}
+
+mkdir "$BENCH_DIR" && cd "$BENCH_DIR" || exit 1
+$VCS_BIN init >> "$LOG_FILE" 2>&1
+
+printf "%10s %12s %12s\n" "commits" "branch ms" "status ms" | tee -a "$LOG_FILE"
+COMMITS=0
+for SIZE in "${SIZES[@]}"; do
+    while [ $COMMITS -lt "$SIZE" ]; do
+        COMMITS=$((COMMITS + 1))
+        echo "$COMMITS" > counter.txt
+        $VCS_BIN add counter.txt >> "$LOG_FILE" 2>&1
+        $VCS_BIN commit -m "Commit $COMMITS" >> "$LOG_FILE" 2>&1 || { echo "FAIL: commit $COMMITS"; exit 1; }
+    done
+    printf "%10s %12s %12s\n" "$COMMITS" "$(average_ms $VCS_BIN branch)" "$(average_ms $VCS_BIN status)" | tee -a "$LOG_FILE"
+done
@@ -0,0 +1,44 @@
+#!/bin/bash
+
+# Flip a file's executable bit on a branch without changing its contents and
+# check that checkout applies the mode in both directions and that diff
+# reports it
+
+TEST_DIR="vcs_checkout_mode_repo"
+LOG_FILE="vcs_checkout_mode_log.txt"
+VCS_BIN="../build/vcs"
+
+rm -rf "$TEST_DIR"
+rm -f "$LOG_FILE"
+
+fail() {
+    echo "FAIL: $1" | tee -a "$LOG_FILE"
+    exit 1
+}
+
+mkdir "$TEST_DIR" && cd "$TEST_DIR" || exit 1
+$VCS_BIN init >> "$LOG_FILE" 2>&1
+
+printf '#!/bin/sh\necho hello\n' > run.sh
+chmod 644 run.sh
+$VCS_BIN add run.sh >> "$LOG_FILE" 2>&1
+$VCS_BIN commit -m "Add script" >> "$LOG_FILE" 2>&1 || fail "first commit failed"
+
+$VCS_BIN branch exec >> "$LOG_FILE" 2>&1
+$VCS_BIN checkout exec >> "$LOG_FILE" 2>&1 || fail "checkout exec failed"
+chmod 755 run.sh
+$VCS_BIN add run.sh >> "$LOG_FILE" 2>&1
+$VCS_BIN commit -m "Make script executable" >> "$LOG_FILE" 2>&1 || fail "second commit failed"
+
+$VCS_BIN checkout main >> "$LOG_FILE" 2>&1 || fail "checkout main failed"
+[ "$(stat -c %a run.sh)" = "644" ] || fail "mode after checkout main is $(stat -c %a run.sh)"
+
+$VCS_BIN checkout exec >> "$LOG_FILE" 2>&1 || fail "checkout exec failed"
+[ "$(stat -c %a run.sh)" = "755" ] || fail "mode after checkout exec is $(stat -c %a run.sh)"
+
+$VCS_BIN diff main exec > diff.out 2>> "$LOG_FILE"
+cat diff.out >> "$LOG_FILE"
+grep -q "^old mode 644" diff.out && grep -q "^new mode 755" diff.out || fail "diff does not report the mode change"
+rm diff.out
+
+echo "PASS: checkout and diff follow mode-only changes" | tee -a "$LOG_FILE"
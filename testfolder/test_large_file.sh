@@ -0,0 +1,57 @@
+#!/bin/bash
+
+# Store and restore a file larger than the configured memory cap and check
+# that peak memory stays below the cap while doing so
+
+TEST_DIR="vcs_large_file_repo"
+LOG_FILE="vcs_large_file_log.txt"
+VCS_BIN="../build/vcs"
+THRESHOLD=$((8 * 1024 * 1024))   # bigFileThreshold written to .vcs/config
+MEMORY_CAP_KB=$((64 * 1024))      # peak RSS allowed for add and restore
+LINES=12000000                    # about 90 MB of text
+
+rm -rf "$TEST_DIR"
+rm -f "$LOG_FILE"
+
+# Run a command and print its peak resident set size in kB
+peak_rss() {
+    "$@" >> "$LOG_FILE" 2>&1 &
+    local pid=$! peak=0 hwm
+    while kill -0 "$pid" 2>/dev/null; do
+        hwm=$(awk '/VmHWM/ {print $2}' "/proc/$pid/status" 2>/dev/null)
+        [ -n "$hwm" ] && peak=$hwm
+        sleep 0.05
+    done
+    wait "$pid" || return 1
+    echo "$peak"
+}
+
+fail() {
+    echo "FAIL: $1" | tee -a "$LOG_FILE"
+    exit 1
+}
+
+mkdir "$TEST_DIR" && cd "$TEST_DIR" || exit 1
+$VCS_BIN init >> "$LOG_FILE" 2>&1
+echo "{\"core\": {\"bigFileThreshold\": $THRESHOLD}}" > .vcs/config
+
+echo "Creating large file..." | tee -a "$LOG_FILE"
+seq 1 $LINES > big.txt
+SIZE_KB=$(( $(stat -c %s big.txt) / 1024 ))
+
+echo "Adding ${SIZE_KB} kB file..." | tee -a "$LOG_FILE"
+PEAK=$(peak_rss $VCS_BIN add big.txt) || fail "add failed"
+echo "Add peak RSS: ${PEAK} kB" | tee -a "$LOG_FILE"
+[ "$PEAK" -lt "$MEMORY_CAP_KB" ] || fail "add used ${PEAK} kB"
+$VCS_BIN commit -m "Large file" >> "$LOG_FILE" 2>&1 || fail "commit failed"
+
+COMMIT=$($VCS_BIN log | sed 's/\x1b\[[0-9;]*m//g' | awk '/^commit/ {print $2; exit}')
+rm big.txt
+
+echo "Restoring large file..." | tee -a "$LOG_FILE"
+PEAK=$(peak_rss $VCS_BIN revert "$COMMIT") || fail "revert failed"
+echo "Restore peak RSS: ${PEAK} kB" | tee -a "$LOG_FILE"
+[ "$PEAK" -lt "$MEMORY_CAP_KB" ] || fail "restore used ${PEAK} kB"
+
+seq 1 $LINES | cmp -s - big.txt || fail "restored file differs"
+echo "PASS: large file round trip stayed under ${MEMORY_CAP_KB} kB" | tee -a "$LOG_FILE"